@@ -39,6 +39,7 @@ along with bRopo.  If not, see <http://www.gnu.org/licenses/>.
 #include "pyravefield.h"
 #include "pyrave_debug.h"
 #include "rave_alloc.h"
+#include "fmi_image_filter_morpho.h"
 
 /**
  * Debug this module
@@ -497,6 +498,9 @@ static PyObject* _pyfmiimage_setOriginalValue(PyFmiImage* self, PyObject* args)
     return NULL;
   }
 
+  if (RaveFmiImage_getImage(self->image)->original == NULL) {
+    raiseException_returnNULL(PyExc_RuntimeError, "Image has no original data");
+  }
   put_pixel_orig(RaveFmiImage_getImage(self->image), x, y, 0, v);
 
   Py_RETURN_NONE;
@@ -516,11 +520,59 @@ static PyObject* _pyfmiimage_getOriginalValue(PyFmiImage* self, PyObject* args)
     return NULL;
   }
 
+  if (RaveFmiImage_getImage(self->image)->original == NULL) {
+    raiseException_returnNULL(PyExc_RuntimeError, "Image has no original data");
+  }
   v = get_pixel_orig(RaveFmiImage_getImage(self->image), x, y, 0);
 
   return PyFloat_FromDouble(v);
 }
 
+/**
+ * Returns the squared Euclidean distance from each gate to the nearest gate with a nonzero
+ * value, see distance_transform_sq.
+ * @param[in] self - self
+ * @param[in] args - (range step, azimuth step[, wrap]). If azimuth step <= 0, the arc length
+ * at the range of each bin is used.
+ * @return a (height, width) double array, inf where no gate is set
+ */
+static PyObject* _pyfmiimage_distanceTransform(PyFmiImage* self, PyObject* args)
+{
+  double rangeStep = 0.0, azimuthStep = 0.0;
+  int wrap = 0, i = 0;
+  double* dist2 = NULL;
+  FmiImage* image = NULL;
+  PyObject* result = NULL;
+  npy_intp dims[2];
+
+  if (!PyArg_ParseTuple(args, "dd|i", &rangeStep, &azimuthStep, &wrap)) {
+    return NULL;
+  }
+  image = RaveFmiImage_getImage(self->image);
+  if (image == NULL || image->array == NULL || image->volume <= 0) {
+    raiseException_returnNULL(PyExc_RuntimeError, "Image has no data");
+  }
+  if (rangeStep <= 0.0) {
+    raiseException_returnNULL(PyExc_ValueError, "Range step must be positive");
+  }
+  dist2 = RAVE_MALLOC(image->volume * sizeof(double));
+  if (dist2 == NULL) {
+    raiseException_returnNULL(PyExc_MemoryError, "Could not allocate distances");
+  }
+  distance_transform_sq(image, dist2, rangeStep, azimuthStep, wrap);
+
+  dims[0] = image->height;
+  dims[1] = image->width;
+  result = PyArray_SimpleNew(2, dims, NPY_DOUBLE);
+  if (result != NULL) {
+    for (i = 0; i < image->area; i++) {
+      *((double*) PyArray_GETPTR2((PyArrayObject*)result, i / image->width, i % image->width)) = dist2[i];
+    }
+  }
+  RAVE_FREE(dist2);
+  return result;
+}
+
 /*@} End Of FmiImage */
 
 /**
@@ -541,6 +593,7 @@ static struct PyMethodDef _pyfmiimage_methods[] =
   {"getValue", (PyCFunction) _pyfmiimage_getValue, 1},
   {"setOriginalValue", (PyCFunction) _pyfmiimage_setOriginalValue, 1},
   {"getOriginalValue", (PyCFunction) _pyfmiimage_getOriginalValue, 1},
+  {"distanceTransform", (PyCFunction) _pyfmiimage_distanceTransform, 1},
   {NULL, NULL} /* sentinel */
 };
 
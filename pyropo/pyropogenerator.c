@@ -32,6 +32,7 @@ along with bRopo.  If not, see <http://www.gnu.org/licenses/>.
 #include "pyropogenerator.h"
 
 #include "pyfmiimage.h"
+#include "pypolarscanparam.h"
 #include "pyrave_debug.h"
 #include "rave_alloc.h"
 
@@ -160,6 +161,40 @@ static PyObject* _pyropogenerator_new(PyObject* self, PyObject* args)
   }
 }
 
+/**
+ * Returns the detectors that can be used in a pipeline, see \ref RaveRopoGenerator_run.
+ * @param[in] self - N/A
+ * @param[in] args - N/A
+ * @return a list of (name, parameters, pgm code) tuples
+ */
+static PyObject* _pyropogenerator_detectors(PyObject* self, PyObject* args)
+{
+  PyObject* result = NULL;
+  int i = 0, count = 0;
+
+  if (!PyArg_ParseTuple(args, "")) {
+    return NULL;
+  }
+  count = RaveRopoGenerator_getDetectorCount();
+  result = PyList_New(0);
+  if (result == NULL) {
+    return NULL;
+  }
+  for (i = 0; i < count; i++) {
+    PyObject* item = Py_BuildValue("(ssi)",
+                                   RaveRopoGenerator_getDetectorName(i),
+                                   RaveRopoGenerator_getDetectorParameters(i),
+                                   (int)RaveRopoGenerator_getDetectorPgmCode(i));
+    if (item == NULL || PyList_Append(result, item) != 0) {
+      Py_XDECREF(item);
+      Py_DECREF(result);
+      return NULL;
+    }
+    Py_DECREF(item);
+  }
+  return result;
+}
+
 /**
  * Returns the image that this generator is run on.
  * @param[in] self - self
@@ -419,6 +454,24 @@ static PyObject* _pyropogenerator_sun2(PyRopoGenerator* self, PyObject* args)
   return (PyObject*)PyRopoGenerator_New(self->generator, NULL);
 }
 
+/**
+ * See \ref RaveRopoGenerator_run
+ * @param[in] self - self
+ * @param[in] args - s (pipeline, e.g. "speck:-30,12;emitter2:-10,3,3")
+ * @return self on success otherwise NULL
+ */
+static PyObject* _pyropogenerator_run(PyRopoGenerator* self, PyObject* args)
+{
+  char* pipeline = NULL;
+  if (!PyArg_ParseTuple(args, "s", &pipeline)) {
+    return NULL;
+  }
+  if (!RaveRopoGenerator_run(self->generator, pipeline)) {
+    raiseException_returnNULL(PyExc_RuntimeWarning, "Failed to run pipeline");
+  }
+  return (PyObject*)PyRopoGenerator_New(self->generator, NULL);
+}
+
 /**
  * See \ref RaveRopoGenerator_classify
  * @param[in] self - self
@@ -497,6 +550,108 @@ static PyObject* _pyropogenerator_restore2(PyRopoGenerator* self, PyObject* args
   return result;
 }
 
+/**
+ * See \ref RaveRopoGenerator_restorePyramid
+ * @param[in] self - self
+ * @param[in] args - ii (threshold)
+ * @return The restored PyFmiImage on success otherwise NULL
+ */
+static PyObject* _pyropogenerator_restorePyramid(PyRopoGenerator* self, PyObject* args)
+{
+  RaveFmiImage_t* image = NULL;
+  PyObject* result = NULL;
+  int threshold = 0;
+  if (!PyArg_ParseTuple(args, "i", &threshold)) {
+    return NULL;
+  }
+  image = RaveRopoGenerator_restorePyramid(self->generator, threshold);
+  if (image == NULL) {
+    raiseException_returnNULL(PyExc_RuntimeWarning, "Failed to classify detector sequence");
+  }
+  result = (PyObject*)PyFmiImage_New(image, 0, 0);
+  RAVE_OBJECT_RELEASE(image);
+  return result;
+}
+
+/**
+ * See \ref RaveRopoGenerator_restoreThresholds
+ * @param[in] self - self
+ * @param[in] args - O|i (sequence of thresholds, if the removed fractions should be returned)
+ * @return a list of restored PyFmiImages, or a tuple (images, fractions), on success otherwise NULL
+ */
+static PyObject* _pyropogenerator_restoreThresholds(PyRopoGenerator* self, PyObject* args)
+{
+  PyObject* inptr = NULL;
+  PyObject* images = NULL;
+  PyObject* pyfractions = NULL;
+  PyObject* result = NULL;
+  RaveObjectList_t* restored = NULL;
+  int* thresholds = NULL;
+  double* fractions = NULL;
+  int withFractions = 0;
+  int count = 0, i = 0;
+
+  if (!PyArg_ParseTuple(args, "O|i", &inptr, &withFractions)) {
+    return NULL;
+  }
+  if (!PySequence_Check(inptr)) {
+    raiseException_returnNULL(PyExc_TypeError, "restoreThresholds takes a sequence of thresholds as input");
+  }
+  count = (int)PySequence_Size(inptr);
+  thresholds = RAVE_MALLOC(sizeof(int) * (count + 1));
+  fractions = RAVE_MALLOC(sizeof(double) * (count + 1));
+  if (thresholds == NULL || fractions == NULL) {
+    raiseException_gotoTag(done, PyExc_MemoryError, "Failed to allocate memory");
+  }
+  for (i = 0; i < count; i++) {
+    PyObject* item = PySequence_GetItem(inptr, i);
+    thresholds[i] = (item != NULL) ? (int)PyLong_AsLong(item) : -1;
+    Py_XDECREF(item);
+    if (PyErr_Occurred()) {
+      raiseException_gotoTag(done, PyExc_TypeError, "thresholds must be integers");
+    }
+  }
+
+  restored = RaveRopoGenerator_restoreThresholds(self->generator, thresholds, count, fractions);
+  if (restored == NULL) {
+    raiseException_gotoTag(done, PyExc_RuntimeWarning, "Failed to restore thresholds");
+  }
+
+  images = PyList_New(0);
+  pyfractions = PyList_New(0);
+  if (images == NULL || pyfractions == NULL) {
+    goto done;
+  }
+  for (i = 0; i < count; i++) {
+    RaveFmiImage_t* image = (RaveFmiImage_t*)RaveObjectList_get(restored, i);
+    PyObject* pyimage = (PyObject*)PyFmiImage_New(image, 0, 0);
+    PyObject* pyfraction = PyFloat_FromDouble(fractions[i]);
+    RAVE_OBJECT_RELEASE(image);
+    if (pyimage == NULL || pyfraction == NULL ||
+        PyList_Append(images, pyimage) != 0 || PyList_Append(pyfractions, pyfraction) != 0) {
+      Py_XDECREF(pyimage);
+      Py_XDECREF(pyfraction);
+      goto done;
+    }
+    Py_DECREF(pyimage);
+    Py_DECREF(pyfraction);
+  }
+
+  if (withFractions) {
+    result = Py_BuildValue("(OO)", images, pyfractions);
+  } else {
+    Py_INCREF(images);
+    result = images;
+  }
+done:
+  Py_XDECREF(images);
+  Py_XDECREF(pyfractions);
+  RAVE_OBJECT_RELEASE(restored);
+  RAVE_FREE(thresholds);
+  RAVE_FREE(fractions);
+  return result;
+}
+
 /**
  * See \ref RaveRopoGenerator_restoreSelf
  * @param[in] self - self
@@ -515,6 +670,99 @@ static PyObject* _pyropogenerator_restoreSelf(PyRopoGenerator* self, PyObject* a
   return (PyObject*)PyRopoGenerator_New(self->generator, NULL);
 }
 
+/**
+ * See \ref RaveRopoGenerator_restoreInto
+ * @param[in] self - self
+ * @param[in] args - Oi (target image, threshold)
+ * @return self on success otherwise NULL
+ */
+static PyObject* _pyropogenerator_restoreInto(PyRopoGenerator* self, PyObject* args)
+{
+  PyObject* inptr = NULL;
+  int threshold = 0;
+  if (!PyArg_ParseTuple(args, "Oi", &inptr, &threshold)) {
+    return NULL;
+  }
+  if (!PyFmiImage_Check(inptr)) {
+    raiseException_returnNULL(PyExc_TypeError, "restoreInto takes a fmi image and threshold as input");
+  }
+  if (!RaveRopoGenerator_restoreInto(self->generator, ((PyFmiImage*)inptr)->image, threshold)) {
+    raiseException_returnNULL(PyExc_RuntimeWarning, "Failed to restore into image");
+  }
+  return (PyObject*)PyRopoGenerator_New(self->generator, NULL);
+}
+
+/**
+ * See \ref RaveRopoGenerator_restore2Into
+ * @param[in] self - self
+ * @param[in] args - Oi (target image, threshold)
+ * @return self on success otherwise NULL
+ */
+static PyObject* _pyropogenerator_restore2Into(PyRopoGenerator* self, PyObject* args)
+{
+  PyObject* inptr = NULL;
+  int threshold = 0;
+  if (!PyArg_ParseTuple(args, "Oi", &inptr, &threshold)) {
+    return NULL;
+  }
+  if (!PyFmiImage_Check(inptr)) {
+    raiseException_returnNULL(PyExc_TypeError, "restore2Into takes a fmi image and threshold as input");
+  }
+  if (!RaveRopoGenerator_restore2Into(self->generator, ((PyFmiImage*)inptr)->image, threshold)) {
+    raiseException_returnNULL(PyExc_RuntimeWarning, "Failed to restore into image");
+  }
+  return (PyObject*)PyRopoGenerator_New(self->generator, NULL);
+}
+
+/**
+ * See \ref RaveRopoGenerator_restorePyramidInto
+ * @param[in] self - self
+ * @param[in] args - Oi (target image, threshold)
+ * @return self on success otherwise NULL
+ */
+static PyObject* _pyropogenerator_restorePyramidInto(PyRopoGenerator* self, PyObject* args)
+{
+  PyObject* inptr = NULL;
+  int threshold = 0;
+  if (!PyArg_ParseTuple(args, "Oi", &inptr, &threshold)) {
+    return NULL;
+  }
+  if (!PyFmiImage_Check(inptr)) {
+    raiseException_returnNULL(PyExc_TypeError, "restorePyramidInto takes a fmi image and threshold as input");
+  }
+  if (!RaveRopoGenerator_restorePyramidInto(self->generator, ((PyFmiImage*)inptr)->image, threshold)) {
+    raiseException_returnNULL(PyExc_RuntimeWarning, "Failed to restore into image");
+  }
+  return (PyObject*)PyRopoGenerator_New(self->generator, NULL);
+}
+
+/**
+ * See \ref RaveRopoGenerator_restoreParameter
+ * @param[in] self - self
+ * @param[in] args - Oi (polar scan parameter, threshold)
+ * @return self on success otherwise NULL
+ */
+static PyObject* _pyropogenerator_restoreParameter(PyRopoGenerator* self, PyObject* args)
+{
+  PyObject* inptr = NULL;
+  PolarScanParam_t* param = NULL;
+  int threshold = 0;
+  int restored = 0;
+  if (!PyArg_ParseTuple(args, "Oi", &inptr, &threshold)) {
+    return NULL;
+  }
+  if (!PyPolarScanParam_Check(inptr)) {
+    raiseException_returnNULL(PyExc_TypeError, "restoreParameter takes a polar scan parameter and threshold as input");
+  }
+  param = PyPolarScanParam_GetNative((PyPolarScanParam*)inptr);
+  restored = RaveRopoGenerator_restoreParameter(self->generator, param, threshold);
+  RAVE_OBJECT_RELEASE(param);
+  if (!restored) {
+    raiseException_returnNULL(PyExc_RuntimeWarning, "Failed to restore parameter");
+  }
+  return (PyObject*)PyRopoGenerator_New(self->generator, NULL);
+}
+
 /**
  * See \ref RaveRopoGenerator_getProbabilityFieldCount
  * @param[in] self - self
@@ -544,9 +792,12 @@ static PyObject* _pyropogenerator_getProbabilityField(PyRopoGenerator* self, PyO
   if (!PyArg_ParseTuple(args, "i", &index)) {
     return NULL;
   }
+  if (index < 0 || index >= RaveRopoGenerator_getProbabilityFieldCount(self->generator)) {
+    raiseException_returnNULL(PyExc_IndexError, "Failed to return probability field at specified index");
+  }
   image = RaveRopoGenerator_getProbabilityField(self->generator, index);
   if (image == NULL) {
-    raiseException_returnNULL(PyExc_IndexError, "Failed to return probability field at specified index");
+    raiseException_returnNULL(PyExc_RuntimeWarning, "Probability field has not been kept, see keepProbabilities");
   }
   result = (PyObject*)PyFmiImage_New(image, 0, 0);
   RAVE_OBJECT_RELEASE(image);
@@ -560,6 +811,8 @@ static struct PyMethodDef _pyropogenerator_methods[] =
 {
   {"classification", NULL, METH_VARARGS},
   {"markers", NULL, METH_VARARGS},
+  {"azimuthWrap", NULL, METH_VARARGS},
+  {"keepProbabilities", NULL, METH_VARARGS},
   {"getImage", (PyCFunction)_pyropogenerator_getImage, 1},
   {"setImage", (PyCFunction)_pyropogenerator_setImage, 1},
   {"threshold", (PyCFunction)_pyropogenerator_threshold, 1},
@@ -574,11 +827,18 @@ static struct PyMethodDef _pyropogenerator_methods[] =
   {"ship", (PyCFunction)_pyropogenerator_ship, 1},
   {"sun", (PyCFunction)_pyropogenerator_sun, 1},
   {"sun2", (PyCFunction)_pyropogenerator_sun2, 1},
+  {"run", (PyCFunction)_pyropogenerator_run, 1},
   {"classify", (PyCFunction)_pyropogenerator_classify, 1},
   {"declassify", (PyCFunction)_pyropogenerator_declassify, 1},
   {"restore", (PyCFunction)_pyropogenerator_restore, 1},
   {"restore2", (PyCFunction)_pyropogenerator_restore2, 1},
   {"restoreSelf", (PyCFunction)_pyropogenerator_restoreSelf, 1},
+  {"restoreThresholds", (PyCFunction)_pyropogenerator_restoreThresholds, 1},
+  {"restoreInto", (PyCFunction)_pyropogenerator_restoreInto, 1},
+  {"restore2Into", (PyCFunction)_pyropogenerator_restore2Into, 1},
+  {"restorePyramid", (PyCFunction)_pyropogenerator_restorePyramid, 1},
+  {"restorePyramidInto", (PyCFunction)_pyropogenerator_restorePyramidInto, 1},
+  {"restoreParameter", (PyCFunction)_pyropogenerator_restoreParameter, 1},
   {"getProbabilityFieldCount", (PyCFunction)_pyropogenerator_getProbabilityFieldCount, 1},
   {"getProbabilityField", (PyCFunction)_pyropogenerator_getProbabilityField, 1},
   {NULL, NULL} /* sentinel */
@@ -609,6 +869,10 @@ static PyObject* _pyropogenerator_getattro(PyRopoGenerator* self, PyObject* name
 	res = (PyObject*)PyFmiImage_New(image,0,0);
 	RAVE_OBJECT_RELEASE(image);
 	return res;
+  } else if (PY_COMPARE_STRING_WITH_ATTRO_NAME("azimuthWrap", name) == 0) {
+    return PyBool_FromLong(RaveRopoGenerator_getAzimuthWrap(self->generator));
+  } else if (PY_COMPARE_STRING_WITH_ATTRO_NAME("keepProbabilities", name) == 0) {
+    return PyBool_FromLong(RaveRopoGenerator_getKeepProbabilities(self->generator));
   }
   return PyObject_GenericGetAttr((PyObject*)self, name);
 }
@@ -623,7 +887,21 @@ static int _pyropogenerator_setattro(PyRopoGenerator* self, PyObject* name, PyOb
     goto done;
   }
 
-  raiseException_gotoTag(done, PyExc_AttributeError, PY_RAVE_ATTRO_NAME_TO_STRING(name));
+  if (PY_COMPARE_STRING_WITH_ATTRO_NAME("azimuthWrap", name) == 0) {
+    if (PyBool_Check(val) || PyLong_Check(val)) {
+      RaveRopoGenerator_setAzimuthWrap(self->generator, PyObject_IsTrue(val));
+    } else {
+      raiseException_gotoTag(done, PyExc_TypeError, "azimuthWrap is a boolean");
+    }
+  } else if (PY_COMPARE_STRING_WITH_ATTRO_NAME("keepProbabilities", name) == 0) {
+    if (PyBool_Check(val) || PyLong_Check(val)) {
+      RaveRopoGenerator_setKeepProbabilities(self->generator, PyObject_IsTrue(val));
+    } else {
+      raiseException_gotoTag(done, PyExc_TypeError, "keepProbabilities is a boolean");
+    }
+  } else {
+    raiseException_gotoTag(done, PyExc_AttributeError, PY_RAVE_ATTRO_NAME_TO_STRING(name));
+  }
 
   result = 0;
 done:
@@ -907,6 +1185,7 @@ static PyObject* _pyropo_update_classification(PyObject* self, PyObject* args)
 /*@{ Module setup */
 static PyMethodDef functions[] = {
   {"new", (PyCFunction)_pyropogenerator_new, 1},
+  {"detectors", (PyCFunction)_pyropogenerator_detectors, 1},
   {NULL,NULL} /*Sentinel*/
 };
 
@@ -941,6 +1220,7 @@ MOD_INIT(_ropogenerator)
   }
 
   import_fmiimage();
+  import_pypolarscanparam();
   PYRAVE_DEBUG_INITIALIZE;
   return MOD_INIT_SUCCESS(module);
 }
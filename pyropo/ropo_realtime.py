@@ -158,22 +158,7 @@ def process_scan(scan, options, quality_control_mode=QUALITY_CONTROL_MODE_ANALYZ
     if options.threshold:
         raw_thresh = int((options.threshold - image.offset) / image.gain)
         rg.threshold(raw_thresh)
-    if options.speck:
-        a, b = options.speck
-        rg.speck(a, b)
-    if scan.elangle * rd < options.elev:
-        if options.speckNormOld:
-            a, b, c = options.speckNormOld
-            rg.speckNormOld(a, b, c)
-        if options.softcut:
-            a, b, c = options.softcut
-            rg.softcut(a, b, c)
-        if options.ship:
-            a, b = options.ship
-            rg.ship(a, b)
-        if options.emitter2:
-            a, b, c = options.emitter2
-            rg.emitter2(a, b, c)
+    rg.run(get_pipeline(options, scan.elangle * rd < options.elev))
 
     classification = rg.classify().classification.toRaveField()
     if options.restore:
@@ -191,6 +176,22 @@ def process_scan(scan, options, quality_control_mode=QUALITY_CONTROL_MODE_ANALYZ
     return scan
 
 
+## Builds the detector pipeline run by \ref process_scan, see \ref RaveRopoGenerator_run
+# @param options variable-length object containing argument names and values
+# @param low if the scan is below the highest elevation where all detectors are run
+# @returns the pipeline string, e.g. "speck:-30,12;emitter2:-10,3,3"
+def get_pipeline(options, low):
+    steps = []
+    detectors = [("speck", options.speck)]
+    if low:
+        detectors += [("speckNormOld", options.speckNormOld), ("softcut", options.softcut),
+                      ("ship", options.ship), ("emitter2", options.emitter2)]
+    for name, args in detectors:
+        if args:
+            steps.append("%s:%s" % (name, ",".join([str(int(v)) for v in args])))
+    return ";".join(steps)
+
+
 ## Loops through a volume and processes scans using \ref process_scan
 # @param pvol input PVOL object
 # @param options variable-length object containing argument names and values
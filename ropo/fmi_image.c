@@ -22,6 +22,7 @@
 
 /*#include <stdio.h> */
 #include <math.h>
+#include <string.h>
 #include <stdlib.h>
 #include "fmi_image.h"
 #include "fmi_util.h"
@@ -120,6 +121,19 @@ int initialize_image(FmiImage *img){
   return 1;
 }
 
+int initialize_byte_image(FmiImage *img){
+  img->type=TRUE_IMAGE;
+  img->area=img->width*img->height;
+  img->volume=img->area*img->channels;
+  img->array=(Byte *) RAVE_MALLOC(img->volume);
+  img->original=NULL;
+  img->coord_overflow_handler_x=BORDER;
+  img->coord_overflow_handler_y=BORDER;
+  img->max_value=255;
+  img->comment_string[0]='\0';
+  return (img->array!=NULL);
+}
+
 int initialize_horz_stripe(FmiImage *img,int width){
   img->width=width;
   img->height=1;
@@ -596,6 +610,60 @@ void min_image(FmiImage *source,FmiImage *source2,FmiImage *target){
     target->array[i]=(source->array[i]<source2->array[i]) ? source->array[i] : source2->array[i];
 }
 
+/* gates per block in max_images_marked() */
+#define MAX_IMAGES_TILE 4096
+
+/* Geometry test without the side effects of check_image_properties() */
+static int same_geometry(FmiImage *a,FmiImage *b){
+  return (a->width==b->width)&&(a->height==b->height)&&(a->channels==b->channels);
+}
+
+void max_images_marked(FmiImage **sources,Byte *codes,int count,FmiImage *target,FmiImage *markers){
+  Byte max[MAX_IMAGES_TILE], mark[MAX_IMAGES_TILE];
+  register int i;
+  int k, start, n;
+  Byte *src, code;
+
+  if (count<1)
+    fmi_error("max_images_marked: no images");
+  for (k=1;k<count;k++)
+    if (!same_geometry(sources[0],sources[k]))
+      fmi_error("max_images_marked: incompatible images");
+  canonize_image(sources[0],target);
+  canonize_image(sources[0],markers);
+
+  /* the running maximum of a block stays in cache while all sources are read */
+  for (start=0;start<target->volume;start+=MAX_IMAGES_TILE){
+    n=MIN(MAX_IMAGES_TILE,target->volume-start);
+    memcpy(max,&sources[0]->array[start],n);
+    memset(mark,codes[0],n);
+    for (k=1;k<count;k++){
+      src=&sources[k]->array[start];
+      code=codes[k];
+      for (i=0;i<n;i++){
+	mark[i]=(src[i]>=max[i]) ? code : mark[i];
+	max[i]=(src[i]>=max[i]) ? src[i] : max[i];
+      }
+    }
+    memcpy(&target->array[start],max,n);
+    memcpy(&markers->array[start],mark,n);
+  }
+}
+
+void max_image_marked(FmiImage *source,Byte code,FmiImage *target,FmiImage *markers){
+  register int i;
+  Byte *src, *max, *mark;
+  if (!same_geometry(source,target)||!same_geometry(source,markers))
+    fmi_error("max_image_marked: incompatible images");
+  src=source->array;
+  max=target->array;
+  mark=markers->array;
+  for (i=0;i<target->volume;i++){
+    mark[i]=(src[i]>=max[i]) ? code : mark[i];
+    max[i]=(src[i]>=max[i]) ? src[i] : max[i];
+  }
+}
+
 void multiply_image_scalar255(FmiImage *img,int coeff){
  register int i;
  int temp;
@@ -170,6 +170,7 @@ int legal_coords(FmiImage *img,int x,int y);
 FmiImage *new_image(int sweep_count); /* Allocator */
 void init_new_image(FmiImage* img);
 int initialize_image(FmiImage *img); /* constructor */
+int initialize_byte_image(FmiImage *img); /* constructor without original data */
 
 void reset_image(FmiImage *img);
 
@@ -232,6 +233,12 @@ void multiply_image255_flex(FmiImage *source,FmiImage *source2,FmiImage *target)
 void multiply_image255_sigmoid(FmiImage *source,FmiImage *source2,FmiImage *target);
 void max_image(FmiImage *source,FmiImage *source2,FmiImage *target);
 void min_image(FmiImage *source,FmiImage *source2,FmiImage *target);
+/* Maximum over count (>=1) images, and in markers the code of the image */
+/* giving the maximum (the last one on ties). Each source is read once. */
+void max_images_marked(FmiImage **sources,Byte *codes,int count,FmiImage *target,FmiImage *markers);
+/* Merges one more image into such a maximum: where source >= target, */
+/* target takes the source value and markers takes code. */
+void max_image_marked(FmiImage *source,Byte code,FmiImage *target,FmiImage *markers);
 
 /* intensity mappings */
 void multiply_image_scalar255(FmiImage *img,int coeff);
@@ -289,6 +296,8 @@ void calc_histogram(FmiImage *source,Histogram hist);
 void clear_histogram(Histogram hist);
 void write_histogram(char *filename,Histogram hist);
 void dump_histogram(Histogram hist);
+/*initialize_horz_stripe */
+int initialize_horz_stripe(FmiImage *img,int width);
 /*initialize_vert_stripe */
 int initialize_vert_stripe(FmiImage *img,int height);
 
@@ -24,6 +24,7 @@
 void image_average_horz(FmiImage *source,FmiImage *vert){
   register int i,j;
   int sum;
+  Byte *row;
 
   /* risky? */
   if ((vert->width!=1)||(vert->height!=source->height))
@@ -32,8 +33,9 @@ void image_average_horz(FmiImage *source,FmiImage *vert){
   /*  for (k=0;k<source->;k++){ */
   for (j=0;j<source->height;j++){
     sum=0;
+    row=&source->array[j*source->width];
     for (i=0;i<source->width;i++)
-      sum+=get_pixel(source,i,j,0);
+      sum+=row[i];
     put_pixel_direct(vert,j,sum/source->width);
     /*    put_pixel(vert,0,j,0,sum/source->width); */
     /*
@@ -48,6 +50,7 @@ void image_average_horz(FmiImage *source,FmiImage *vert){
 void image_average_vert(FmiImage *source,FmiImage *vert){
   register int i,j;
   int sum;
+  Byte *row;
 
   /* risky? */
   if ((vert->width!=1)||(vert->height!=source->height))
@@ -56,8 +59,9 @@ void image_average_vert(FmiImage *source,FmiImage *vert){
   /*  for (k=0;k<source->;k++){ */
   for (j=0;j<source->height;j++){
     sum=0;
+    row=&source->array[j*source->width];
     for (i=0;i<source->width;i++)
-      sum+=get_pixel(source,i,j,0);
+      sum+=row[i];
     put_pixel_direct(vert,j,sum/source->width);
   }
 }
@@ -0,0 +1,253 @@
+/**
+
+    Copyright 2001 - 2010  Markus Peura,
+    Finnish Meteorological Institute (First.Last@fmi.fi)
+
+
+    This file is part of bRopo.
+
+    bRopo is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    bRopo is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser Public License for more details.
+
+    You should have received a copy of the GNU Lesser Public License
+    along with bRopo.  If not, see <http://www.gnu.org/licenses/>. */
+
+#include <stdlib.h>
+#include <string.h>
+#include "fmi_util.h"
+#include "fmi_image.h"
+#include "fmi_image_bits.h"
+#include "rave_alloc.h"
+
+/* valid bits of the last word of a row */
+static FmiBitWord tail_mask(int width){
+  int r=width%FMI_BITS_PER_WORD;
+  return (r==0) ? ~(FmiBitWord)0 : (((FmiBitWord)1)<<r)-1;
+}
+
+void init_new_bit_image(FmiBitImage *img){
+  img->width=0;
+  img->height=0;
+  img->channels=0;
+  img->words=0;
+  img->array=NULL;
+}
+
+int initialize_bit_image(FmiBitImage *img,int width,int height,int channels){
+  img->width=width;
+  img->height=height;
+  img->channels=channels;
+  img->words=(width+FMI_BITS_PER_WORD-1)/FMI_BITS_PER_WORD;
+  img->array=(FmiBitWord *)RAVE_MALLOC(MAX(img->words*height*channels,1)*sizeof(FmiBitWord));
+  if (img->array==NULL)
+    fmi_error("initialize_bit_image: memory allocation failed");
+  memset(img->array,0,img->words*height*channels*sizeof(FmiBitWord));
+  return 1;
+}
+
+void reset_bit_image(FmiBitImage *img){
+  RAVE_FREE(img->array);
+  init_new_bit_image(img);
+}
+
+void canonize_bit_image(FmiBitImage *sample,FmiBitImage *target){
+  if ((target->array!=NULL)&&(target->width==sample->width)&&
+      (target->height==sample->height)&&(target->channels==sample->channels))
+    return;
+  reset_bit_image(target);
+  initialize_bit_image(target,sample->width,sample->height,sample->channels);
+}
+
+void image_to_bits(FmiImage *source,FmiBitImage *target,Byte threshold){
+  register int b;
+  int r,w,n;
+  Byte *p;
+  FmiBitWord word,*q;
+
+  if ((target->array==NULL)||(target->width!=source->width)||
+      (target->height!=source->height)||(target->channels!=source->channels)){
+    reset_bit_image(target);
+    initialize_bit_image(target,source->width,source->height,source->channels);
+  }
+  for (r=0;r<source->height*source->channels;r++){
+    p=&source->array[r*source->width];
+    q=&target->array[r*target->words];
+    for (w=0;w<target->words;w++){
+      n=MIN(FMI_BITS_PER_WORD,source->width-w*FMI_BITS_PER_WORD);
+      word=0;
+      for (b=0;b<n;b++)
+	if (p[b]>threshold)
+	  word|=((FmiBitWord)1)<<b;
+      q[w]=word;
+      p+=n;
+    }
+  }
+}
+
+void bits_to_image(FmiBitImage *source,FmiImage *target,Byte c){
+  register int b;
+  int r,w,n;
+  Byte *p;
+  FmiBitWord word,*q;
+
+  if (target->type==NULL_IMAGE){
+    target->width=source->width;
+    target->height=source->height;
+    target->channels=source->channels;
+    initialize_image(target);
+  }
+  else if ((target->width!=source->width)||(target->height!=source->height)||(target->channels!=source->channels))
+    fmi_error("bits_to_image: incompatible image geometry");
+
+  for (r=0;r<source->height*source->channels;r++){
+    p=&target->array[r*source->width];
+    q=&source->array[r*source->words];
+    for (w=0;w<source->words;w++){
+      n=MIN(FMI_BITS_PER_WORD,source->width-w*FMI_BITS_PER_WORD);
+      word=q[w];
+      if (word==0)
+	memset(p,0,n);
+      else
+	for (b=0;b<n;b++)
+	  p[b]=((word>>b)&1) ? c : 0;
+      p+=n;
+    }
+  }
+}
+
+void bits_not(FmiBitImage *source,FmiBitImage *target){
+  register int i;
+  int r;
+  FmiBitWord mask;
+  canonize_bit_image(source,target);
+  for (i=0;i<source->words*source->height*source->channels;i++)
+    target->array[i]=~source->array[i];
+  if (source->words==0)
+    return;
+  mask=tail_mask(source->width);
+  for (r=0;r<source->height*source->channels;r++)
+    target->array[(r+1)*source->words-1]&=mask;
+}
+
+/* word w of a row displaced by s gates (s>0 towards larger x), zeros shifted in */
+static FmiBitWord shifted_word(FmiBitWord *row,int words,int w,int s){
+  int q,r,lo;
+  FmiBitWord a,b;
+  if (s>=0){
+    q=s/FMI_BITS_PER_WORD;
+    r=s%FMI_BITS_PER_WORD;
+    lo=w-q;
+    a=(lo>=0) ? row[lo] : 0;
+    if (r==0)
+      return a;
+    b=(lo-1>=0) ? row[lo-1] : 0;
+    return (a<<r)|(b>>(FMI_BITS_PER_WORD-r));
+  }
+  else {
+    s=-s;
+    q=s/FMI_BITS_PER_WORD;
+    r=s%FMI_BITS_PER_WORD;
+    lo=w+q;
+    a=(lo<words) ? row[lo] : 0;
+    if (r==0)
+      return a;
+    b=(lo+1<words) ? row[lo+1] : 0;
+    return (a>>r)|(b<<(FMI_BITS_PER_WORD-r));
+  }
+}
+
+/* out(x) = OR of gates x-sign*(0..length-1) of row, zero outside the row */
+/* Doubling: a window of n gates joined with its copy displaced by s<=n gates */
+/* covers n+s gates, so the cost is log2(length) shifts per word. */
+static void window_row(FmiBitWord *row,FmiBitWord *out,FmiBitWord *temp,int words,int length,int sign){
+  register int w;
+  int n,s;
+  memcpy(out,row,words*sizeof(FmiBitWord));
+  for (n=1;n<length;n+=s){
+    s=MIN(n,length-n);
+    memcpy(temp,out,words*sizeof(FmiBitWord));
+    for (w=0;w<words;w++)
+      out[w]|=shifted_word(temp,words,w,sign*s);
+  }
+}
+
+/* As above for whole rows: out(j) = OR of rows j+sign*(0..length-1) */
+static void window_rows(FmiBitWord *source,FmiBitWord *out,FmiBitWord *temp,int words,int height,int length,int sign,int wrap){
+  register int w;
+  int j,jj,n,s;
+  FmiBitWord *row;
+  memcpy(out,source,words*height*sizeof(FmiBitWord));
+  if (wrap)
+    length=MIN(length,height);
+  for (n=1;n<length;n+=s){
+    s=MIN(n,length-n);
+    memcpy(temp,out,words*height*sizeof(FmiBitWord));
+    for (j=0;j<height;j++){
+      jj=j+sign*s;
+      if (wrap){
+	jj=jj%height;
+	if (jj<0) jj+=height;
+      }
+      else if ((jj<0)||(jj>=height))
+	continue;
+      row=&temp[jj*words];
+      for (w=0;w<words;w++)
+	out[j*words+w]|=row[w];
+    }
+  }
+}
+
+void bits_dilate(FmiBitImage *source,FmiBitImage *target,int hrad,int vrad,int wrap){
+  register int i;
+  int r,k,rows,n;
+  FmiBitWord mask,*work,*horz,*left,*right,*temp;
+
+  rows=source->height*source->channels;
+  n=source->words*source->height;
+  mask=tail_mask(source->width);
+  work=(FmiBitWord *)RAVE_MALLOC(MAX(source->words*rows+3*n,1)*sizeof(FmiBitWord));
+  if (work==NULL)
+    fmi_error("bits_dilate: memory allocation failed");
+  horz=work;
+  left=&horz[source->words*rows];
+  right=&left[n];
+  temp=&right[n];
+
+  /* HORIZONTAL: OR of gates x-hrad..x, and of x..x+hrad */
+  for (r=0;r<rows;r++){
+    window_row(&source->array[r*source->words],left,temp,source->words,hrad+1,1);
+    window_row(&source->array[r*source->words],right,temp,source->words,hrad+1,-1);
+    for (i=0;i<source->words;i++)
+      horz[r*source->words+i]=left[i]|right[i];
+    if (source->words>0)
+      horz[(r+1)*source->words-1]&=mask;
+  }
+
+  /* VERTICAL: OR of rays j-vrad..j, and of j..j+vrad */
+  canonize_bit_image(source,target);
+  for (k=0;k<source->channels;k++){
+    window_rows(&horz[k*n],left,temp,source->words,source->height,vrad+1,-1,wrap);
+    window_rows(&horz[k*n],right,temp,source->words,source->height,vrad+1,1,wrap);
+    for (i=0;i<n;i++)
+      target->array[k*n+i]=left[i]|right[i];
+  }
+  RAVE_FREE(work);
+}
+
+void bits_erode(FmiBitImage *source,FmiBitImage *target,int hrad,int vrad,int wrap){
+  bits_not(source,target);
+  bits_dilate(target,target,hrad,vrad,wrap);
+  bits_not(target,target);
+}
+
+void bits_closing(FmiBitImage *source,FmiBitImage *target,int hrad,int vrad,int wrap){
+  bits_dilate(source,target,hrad,vrad,wrap);
+  bits_erode(target,target,hrad,vrad,wrap);
+}
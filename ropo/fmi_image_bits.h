@@ -0,0 +1,67 @@
+/**
+
+    Copyright 2001 - 2010  Markus Peura,
+    Finnish Meteorological Institute (First.Last@fmi.fi)
+
+
+    This file is part of bRopo.
+
+    bRopo is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    bRopo is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser Public License for more details.
+
+    You should have received a copy of the GNU Lesser Public License
+    along with bRopo.  If not, see <http://www.gnu.org/licenses/>. */
+
+
+
+#ifndef __FMI_IMAGE_BITS__
+#define __FMI_IMAGE_BITS__
+
+#include <stdint.h>
+#include "fmi_image.h"
+
+/* BIT-PACKED BINARY IMAGES */
+/* Gate x of row j (channel k) is bit x%64 of word */
+/* array[(k*height+j)*words + x/64]. Padding bits beyond width are kept zero. */
+/* Outside the image, gates are ignored by the morphological operations, */
+/* as with the BORDER coordinate handling of pipeline_process(). */
+
+typedef uint64_t FmiBitWord;
+#define FMI_BITS_PER_WORD 64
+
+struct fmi_bit_image {
+  int width,height,channels;
+  int words;   /* words per row */
+  FmiBitWord *array;
+};
+
+typedef struct fmi_bit_image FmiBitImage;
+
+void init_new_bit_image(FmiBitImage *img);
+int initialize_bit_image(FmiBitImage *img,int width,int height,int channels);
+void reset_bit_image(FmiBitImage *img);
+void canonize_bit_image(FmiBitImage *sample,FmiBitImage *target);
+
+/* Set bits where source > threshold. */
+void image_to_bits(FmiImage *source,FmiBitImage *target,Byte threshold);
+/* Write c to set bits and 0 elsewhere. Target is initialized if it is an empty image. */
+void bits_to_image(FmiBitImage *source,FmiImage *target,Byte c);
+
+void bits_not(FmiBitImage *source,FmiBitImage *target);
+
+/* Rectangular structuring element of (2*hrad+1)x(2*vrad+1) gates. */
+/* If wrap is nonzero, the first and last rays are neighbours. Target may equal source. */
+/* Cost per word is logarithmic in hrad and vrad. */
+void bits_dilate(FmiBitImage *source,FmiBitImage *target,int hrad,int vrad,int wrap);
+void bits_erode(FmiBitImage *source,FmiBitImage *target,int hrad,int vrad,int wrap);
+/* Same result as morph_closing() of a binary image. */
+void bits_closing(FmiBitImage *source,FmiBitImage *target,int hrad,int vrad,int wrap);
+
+#endif
@@ -20,9 +20,11 @@
     along with bRopo.  If not, see <http://www.gnu.org/licenses/>. */
 
 #include <math.h> 
+#include <string.h>
 #include "fmi_util.h"
 #include "fmi_image.h"
 #include "fmi_image_filter.h"
+#include "rave_alloc.h"
 
 void detect_vert_gradient(FmiImage *source, FmiImage *trace)
 {
@@ -48,24 +50,28 @@ void detect_vert_gradient(FmiImage *source, FmiImage *trace)
   }
 }
 
+/* Rows are swept one at a time so that memory is accessed sequentially; */
+/* neighbours outside the image are fetched with get_pixel (overflow handlers). */
 void detect_horz_gradient(FmiImage *source, FmiImage *trace)
 {
   int i, j, k;
-  int i_left, i_right;
-  int g;
+  int g, g_left, g_right;
+  Byte *src, *dst;
   canonize_image(source, trace);
 
   for (k = 0; k < source->channels; k++) {
-    for (i = 0; i < source->width; i++) {
-      i_left = i - 1;
-      i_right = i + 1;
-      for (j = 0; j < source->height; j++) {
-        g = (get_pixel(source, i_right, j, k) - get_pixel(source, i_left, j, k)) / 2 + 128;
+    for (j = 0; j < source->height; j++) {
+      src = &source->array[k * source->area + j * source->width];
+      dst = &trace->array[k * trace->area + j * trace->width];
+      for (i = 0; i < source->width; i++) {
+        g_left = (i > 0) ? src[i - 1] : get_pixel(source, i - 1, j, k);
+        g_right = (i < source->width - 1) ? src[i + 1] : get_pixel(source, i + 1, j, k);
+        g = (g_right - g_left) / 2 + 128;
         if (g > 254)
           g = 254;
         if (g < 2)
           g = 2;
-        put_pixel(trace, i, j, k, g);
+        dst[i] = g;
       }
     }
   }
@@ -75,21 +81,23 @@ void detect_horz_gradient(FmiImage *source, FmiImage *trace)
 void detect_vert_maxima(FmiImage *source,FmiImage *trace){
 	int i,j,k;
 	Byte g,g_upper,g_lower,gmax;
+	Byte *up,*src,*down,*dst;
 	canonize_image(source,trace);
 	/*check_image_properties(source,trace); */
 
 	for (k=0;k<source->channels;k++){
 		for (j=1;j<source->height-1;j++){
+			src=&source->array[k*source->area+j*source->width];
+			up=src-source->width;
+			down=src+source->width;
+			dst=&trace->array[k*trace->area+j*trace->width];
 			for (i=0;i<source->width;i++){
-				g = get_pixel(source,i,j,k);
-				g_upper = get_pixel(source,i,j-1,k);
-				g_lower = get_pixel(source,i,j+1,k);
+				g = src[i];
+				g_upper = up[i];
+				g_lower = down[i];
 				gmax = MAX(g_upper,g_lower);
 				/*put_pixel(trace,i,j,k,gmax); */
-				if (g>gmax)
-					put_pixel(trace,i,j,k,(Byte)(g-gmax));
-				else
-					put_pixel(trace,i,j,k,0);
+				dst[i] = (g>gmax) ? (Byte)(g-gmax) : 0;
 			}
 		}
 	}
@@ -101,23 +109,27 @@ void detect_vert_maxima2(FmiImage *source, FmiImage *trace)
   int i, j, k;
   Byte g, g_sum; /*g_upper,g_lower; */
   int gt;
+  Byte *up, *src, *down, *dst;
   canonize_image(source, trace);
   /*check_image_properties(source,trace); */
 
   for (k = 0; k < source->channels; k++) {
     for (j = 1; j < source->height - 1; j++) {
+      src = &source->array[k * source->area + j * source->width];
+      up = src - source->width;
+      down = src + source->width;
+      dst = &trace->array[k * trace->area + j * trace->width];
       for (i = 0; i < source->width; i++) {
-        g = get_pixel(source, i, j, k);
+        g = src[i];
         /*	g_upper=get_pixel(source,i,j-1,k);
          g_lower=get_pixel(source,i,j+1,k);
          gt=(2*g-g_upper-g_lower)/(1+g_upper+g_lower);
          */
-        g_sum = (get_pixel(source, i, j - 1, k)
-            + get_pixel(source, i, j + 1, k));
+        g_sum = (up[i] + down[i]);
         gt = (2 * g - g_sum) / (1 + g_sum);
         gt = MAX(0,gt);
         /*	gt=pseudo_sigmoid(128,gt); */
-        put_pixel(trace, i, j, k, gt);
+        dst[i] = (Byte) gt;
       }
     }
   }
@@ -127,17 +139,22 @@ void detect_horz_edges(FmiImage *source, FmiImage *trace)
 {
   int i, j, k;
   int g, g2;
+  Byte *up, *src, *down, *dst;
   canonize_image(source, trace);
   /*check_image_properties(source,trace); */
 
   for (k = 0; k < source->channels; k++) {
     for (j = 1; j < source->height - 1; j++) {
+      src = &source->array[k * source->area + j * source->width];
+      up = src - source->width;
+      down = src + source->width;
+      dst = &trace->array[k * trace->area + j * trace->width];
       for (i = 0; i < source->width; i++) {
-        g = get_pixel(source, i, j, k) - get_pixel(source, i, j - 1, k);
-        g2 = get_pixel(source, i, j, k) - get_pixel(source, i, j + 1, k);
+        g = src[i] - up[i];
+        g2 = src[i] - down[i];
         g = MAX(g,g2);
         g = MAX(0,g);
-        put_pixel(trace, i, j, k, g);
+        dst[i] = g;
       }
     }
   }
@@ -149,18 +166,21 @@ void detect_horz_maxima(FmiImage *source, FmiImage *trace)
 {
   int i, j, k;
   unsigned char g, g_left, g_right, gmax, gt;
+  Byte *src, *dst;
   canonize_image(source, trace);
 
   for (k = 0; k < source->channels; k++) {
-    for (i = 1; i < source->width - 1; i++) {
-      for (j = 0; j < source->height; j++) {
-        g = get_pixel(source, i, j, k);
-        g_left = get_pixel(source, i - 1, j, k);
-        g_right = get_pixel(source, i + 1, j, k);
+    for (j = 0; j < source->height; j++) {
+      src = &source->array[k * source->area + j * source->width];
+      dst = &trace->array[k * trace->area + j * trace->width];
+      for (i = 1; i < source->width - 1; i++) {
+        g = src[i];
+        g_left = src[i - 1];
+        g_right = src[i + 1];
         gmax = MAX(g_left,g_right);
         if (g > gmax) {
-          gt = get_pixel(trace, i, j, k);
-          put_pixel(trace, i, j, k, MAX(gt,g-gmax));
+          gt = dst[i];
+          dst[i] = MAX(gt,g-gmax);
         }
         /*	else */
         /*  put_pixel(trace,i,j,k,0); */
@@ -172,17 +192,23 @@ void detect_horz_maxima(FmiImage *source, FmiImage *trace)
 void detect_vert_edges(FmiImage *source,FmiImage *trace){
   int i,j,k;
   int g,g2;
+  Byte *src,*dst;
   canonize_image(source,trace);
   /*check_image_properties(source,trace); */
 
   for (k=0;k<source->channels;k++){
-    for (i=1;i<source->width-1;i++){
-     for (j=0;j<source->height;j++){
-       g =get_pixel(source,i,j,k)-get_pixel(source,i-1,j,k);
-       g2=get_pixel(source,i,j,k)-get_pixel(source,i+1,j,k);
-       g=MAX(g,g2);
-       g=MAX(0,g);
-       put_pixel(trace,i,j,k,g);}
+    for (j=0;j<source->height;j++){
+      src=&source->array[k*source->area+j*source->width];
+      dst=&trace->array[k*trace->area+j*trace->width];
+      /* no edge is defined at the outermost bins */
+      dst[0]=0;
+      dst[source->width-1]=0;
+      for (i=1;i<source->width-1;i++){
+	g =src[i]-src[i-1];
+	g2=src[i]-src[i+1];
+	g=MAX(g,g2);
+	g=MAX(0,g);
+	dst[i]=g;}
     }
   }
   if (FMI_DEBUG(5)) write_image("debug_edges",trace,PGM_RAW);
@@ -192,14 +218,17 @@ void iir_right(FmiImage *source, FmiImage *trace, int promille)
 {
   int i, j, k;
   int g, g_old;
+  Byte *src, *dst;
   canonize_image(source, trace);
   for (k = 0; k < source->channels; k++)
     for (j = 0; j < source->height; j++) {
+      src = &source->array[k * source->area + j * source->width];
+      dst = &trace->array[k * trace->area + j * trace->width];
       g_old = 0;
       for (i = 0; i < source->width; i++) {
-        g = get_pixel(source, i, j, k);
+        g = src[i];
         g = MAX(g,g_old);
-        put_pixel(trace, i, j, k, g);
+        dst[i] = g;
         g_old = g * promille / 1000;
       }
     }
@@ -211,14 +240,17 @@ void iir_left(FmiImage *source, FmiImage *trace, int promille)
 {
   int i, j, k;
   int g, g_old;
+  Byte *src, *dst;
   canonize_image(source, trace);
   for (k = 0; k < source->channels; k++)
     for (j = 0; j < source->height; j++) {
+      src = &source->array[k * source->area + j * source->width];
+      dst = &trace->array[k * trace->area + j * trace->width];
       g_old = 0;
       for (i = source->width - 1; i >= 0; i--) {
-        g = get_pixel(source, i, j, k);
+        g = src[i];
         g = MAX(g,g_old);
-        put_pixel(trace, i, j, k, g);
+        dst[i] = g;
         g_old = g * promille / 1000;
       }
     }
@@ -229,18 +261,28 @@ void iir_left(FmiImage *source, FmiImage *trace, int promille)
 void iir_up(FmiImage *source, FmiImage *trace, int promille)
 {
   int i, j, k;
-  int g, g_old;
+  int g, *g_old;
+  Byte *src, *dst;
   canonize_image(source, trace);
-  for (k = 0; k < source->channels; k++)
-    for (i = 0; i < source->width; i++) {
-      g_old = 0;
-      for (j = 0; j < source->height; j++) {
-        g = get_pixel(source, i, j, k);
-        g = MAX(g,g_old);
-        put_pixel(trace, i, j, k, g);
-        g_old = g * promille / 1000;
+  /* one filter state per column, rows swept sequentially */
+  g_old = (int *) RAVE_MALLOC(MAX(source->width, 1) * sizeof(int));
+  if (g_old == NULL)
+    fmi_error("iir_up: memory allocation failed");
+  for (k = 0; k < source->channels; k++) {
+    for (i = 0; i < source->width; i++)
+      g_old[i] = 0;
+    for (j = 0; j < source->height; j++) {
+      src = &source->array[k * source->area + j * source->width];
+      dst = &trace->array[k * trace->area + j * trace->width];
+      for (i = 0; i < source->width; i++) {
+        g = src[i];
+        g = MAX(g,g_old[i]);
+        dst[i] = g;
+        g_old[i] = g * promille / 1000;
       }
     }
+  }
+  RAVE_FREE(g_old);
   if (FMI_DEBUG(5))
     write_image("debug_iir_up", trace, PGM_RAW);
 }
@@ -248,22 +290,88 @@ void iir_up(FmiImage *source, FmiImage *trace, int promille)
 void iir_down(FmiImage *source, FmiImage *trace, int promille)
 {
   int i, j, k;
-  int g, g_old;
+  int g, *g_old;
+  Byte *src, *dst;
   canonize_image(source, trace);
-  for (k = 0; k < source->channels; k++)
-    for (i = 0; i < source->width; i++) {
-      g_old = 0;
-      for (j = source->height - 1; j >= 0; j--) {
-        g = get_pixel(source, i, j, k);
-        g = MAX(g,g_old);
-        put_pixel(trace, i, j, k, g);
-        g_old = g * promille / 1000;
+  /* one filter state per column, rows swept sequentially */
+  g_old = (int *) RAVE_MALLOC(MAX(source->width, 1) * sizeof(int));
+  if (g_old == NULL)
+    fmi_error("iir_down: memory allocation failed");
+  for (k = 0; k < source->channels; k++) {
+    for (i = 0; i < source->width; i++)
+      g_old[i] = 0;
+    for (j = source->height - 1; j >= 0; j--) {
+      src = &source->array[k * source->area + j * source->width];
+      dst = &trace->array[k * trace->area + j * trace->width];
+      for (i = 0; i < source->width; i++) {
+        g = src[i];
+        g = MAX(g,g_old[i]);
+        dst[i] = g;
+        g_old[i] = g * promille / 1000;
       }
     }
+  }
+  RAVE_FREE(g_old);
   if (FMI_DEBUG(5))
     write_image("debug_iir_down", trace, PGM_RAW);
 }
 
+/* Symmetric vertical IIR: the maximum of iir_up and iir_down, computed */
+/* with two row sweeps and no intermediate images. */
+void iir_updown(FmiImage *source, FmiImage *trace, int promille)
+{
+  int i, j, k;
+  int g, *g_old;
+  Byte *src, *dst, *copy;
+  canonize_image(source, trace);
+  g_old = (int *) RAVE_MALLOC(MAX(source->width, 1) * sizeof(int));
+  if (g_old == NULL)
+    fmi_error("iir_updown: memory allocation failed");
+  /* the downward sweep needs the unfiltered input */
+  copy = NULL;
+  if (source->array == trace->array) {
+    copy = (Byte *) RAVE_MALLOC(MAX(source->volume, 1) * sizeof(Byte));
+    if (copy == NULL)
+      fmi_error("iir_updown: memory allocation failed");
+    memcpy(copy, source->array, source->volume * sizeof(Byte));
+  }
+  for (k = 0; k < source->channels; k++) {
+    for (i = 0; i < source->width; i++)
+      g_old[i] = 0;
+    for (j = 0; j < source->height; j++) {
+      src = &source->array[k * source->area + j * source->width];
+      dst = &trace->array[k * trace->area + j * trace->width];
+      for (i = 0; i < source->width; i++) {
+        g = src[i];
+        g = MAX(g,g_old[i]);
+        dst[i] = g;
+        g_old[i] = g * promille / 1000;
+      }
+    }
+    for (i = 0; i < source->width; i++)
+      g_old[i] = 0;
+    for (j = source->height - 1; j >= 0; j--) {
+      if (copy != NULL)
+        src = &copy[k * source->area + j * source->width];
+      else
+        src = &source->array[k * source->area + j * source->width];
+      dst = &trace->array[k * trace->area + j * trace->width];
+      for (i = 0; i < source->width; i++) {
+        g = src[i];
+        g = MAX(g,g_old[i]);
+        g_old[i] = g * promille / 1000;
+        if (g > dst[i])
+          dst[i] = g;
+      }
+    }
+  }
+  if (copy != NULL)
+    RAVE_FREE(copy);
+  RAVE_FREE(g_old);
+  if (FMI_DEBUG(5))
+    write_image("debug_iir_updown", trace, PGM_RAW);
+}
+
 void mask_image(FmiImage *source, FmiImage *mask, Byte threshold, Byte c)
 {
   register int i;
@@ -293,6 +401,114 @@ void binarize_image(FmiImage *source,FmiImage *target,Byte c){
 }
 
 #define MAXVAL 250
+
+/* Marker update shared by all propagate kernels; overflow is the value */
+/* to which the marker falls back after exceeding MAXVAL. */
+#define PROPAGATE_STEP(c,d,s,slope,overflow) \
+  if ((d) > 0) { \
+    if ((c) == 0) { \
+      (c) = (s); \
+      if ((c) == 0) \
+        (c) = 1; \
+    } else { \
+      (c) = (c) + (slope); \
+      if ((c) > MAXVAL) \
+        (c) = (overflow); \
+      if ((c) < 1) \
+        (c) = 1; \
+    } \
+  } else \
+    (c) = 0;
+
+#define PROPAGATE_ASSIGN(p,c) (p) = (Byte) (c)
+#define PROPAGATE_MIN(p,c) if ((Byte) (c) < (p)) (p) = (Byte) (c)
+#define PROPAGATE_MAX(p,c) if ((Byte) (c) > (p)) (p) = (Byte) (c)
+
+/* Row kernels replacing the put_pixel, put_pixel_min and put_pixel_max */
+/* callbacks: horz walks one row in direction step, vert advances one row */
+/* of per-column markers c. A NULL src acts as a source of ones. */
+#define PROPAGATE_KERNELS(op,STORE) \
+static void propagate_horz_##op(Byte *dom, Byte *src, Byte *dst, int width, \
+  int step, int slope, int overflow) \
+{ \
+  register int i, n; \
+  int c = 0; \
+  i = (step > 0) ? 0 : width - 1; \
+  for (n = 0; n < width; n++, i += step) { \
+    PROPAGATE_STEP(c, dom[i], (src != NULL) ? src[i] : 1, slope, overflow) \
+    STORE(dst[i], c); \
+  } \
+} \
+static void propagate_vert_##op(Byte *dom, Byte *src, Byte *dst, int *c, \
+  int width, int slope, int overflow) \
+{ \
+  register int i; \
+  for (i = 0; i < width; i++) { \
+    PROPAGATE_STEP(c[i], dom[i], (src != NULL) ? src[i] : 1, slope, overflow) \
+    STORE(dst[i], c[i]); \
+  } \
+}
+
+PROPAGATE_KERNELS(assign,PROPAGATE_ASSIGN)
+PROPAGATE_KERNELS(min,PROPAGATE_MIN)
+PROPAGATE_KERNELS(max,PROPAGATE_MAX)
+
+typedef void (*PropagateHorzKernel)(Byte *, Byte *, Byte *, int, int, int, int);
+typedef void (*PropagateVertKernel)(Byte *, Byte *, Byte *, int *, int, int, int);
+
+/* Direct row access requires images of identical geometry. */
+static int propagate_direct(FmiImage *source, FmiImage *domain, FmiImage *target)
+{
+  if ((target->width != domain->width) || (target->height != domain->height)
+    || (target->channels != domain->channels))
+    return 0;
+  if ((source != NULL) && ((source->width != domain->width)
+    || (source->height != domain->height) || (source->channels != domain->channels)))
+    return 0;
+  return 1;
+}
+
+static PropagateHorzKernel propagate_horz_kernel(void(* put_func)(FmiImage *, int, int, int, Byte))
+{
+  if (put_func == put_pixel)
+    return propagate_horz_assign;
+  if (put_func == put_pixel_min)
+    return propagate_horz_min;
+  if (put_func == put_pixel_max)
+    return propagate_horz_max;
+  return NULL;
+}
+
+static PropagateVertKernel propagate_vert_kernel(void(* put_func)(FmiImage *, int, int, int, Byte))
+{
+  if (put_func == put_pixel)
+    return propagate_vert_assign;
+  if (put_func == put_pixel_min)
+    return propagate_vert_min;
+  if (put_func == put_pixel_max)
+    return propagate_vert_max;
+  return NULL;
+}
+
+/* Runs a horizontal kernel over every row; returns 0 if the generic */
+/* put_func path is needed instead. */
+static int propagate_horz_rows(FmiImage *source, FmiImage *domain, FmiImage *target,
+  signed char slope, void(* put_func)(FmiImage *, int, int, int, Byte),
+  int step, int overflow)
+{
+  int j, k;
+  PropagateHorzKernel kernel;
+  kernel = propagate_horz_kernel(put_func);
+  if ((kernel == NULL) || !propagate_direct(source, domain, target))
+    return 0;
+  for (k = 0; k < domain->channels; k++)
+    for (j = 0; j < domain->height; j++)
+      kernel(&domain->array[k * domain->area + j * domain->width],
+        (source != NULL) ? &source->array[k * source->area + j * source->width] : NULL,
+        &target->array[k * target->area + j * target->width],
+        domain->width, step, slope, overflow);
+  return 1;
+}
 void propagate_right(FmiImage *source, FmiImage *domain, FmiImage *target,
   signed char slope, void(* put_func)(FmiImage *, int, int, int, Byte))
 {
@@ -302,6 +518,8 @@ void propagate_right(FmiImage *source, FmiImage *domain, FmiImage *target,
   check_image_properties(domain, target);
   if (source != NULL)
     check_image_properties(domain, source);
+  if (propagate_horz_rows(source, domain, target, slope, put_func, 1, MAXVAL - 1))
+    return;
   for (k = 0; k < domain->channels; k++) {
     for (j = 0; j < domain->height; j++) {
       c = 0;
@@ -339,6 +557,8 @@ void propagate_left(FmiImage *source, FmiImage *domain, FmiImage *target,
   register int i, j, k;
   int c;
 
+  if (propagate_horz_rows(source, domain, target, slope, put_func, -1, MAXVAL - 2))
+    return;
   for (k = 0; k < domain->channels; k++) {
     for (j = 0; j < domain->height; j++) {
       c = 0;
@@ -376,110 +596,261 @@ void propagate_up(FmiImage *source, FmiImage *domain, FmiImage *target,
   signed char slope, void(* put_func)(FmiImage *, int, int, int, Byte))
 {
   register int i, j, k;
-  int c;
-
+  int *c;
+  Byte *dom, *src, *dst;
+  PropagateVertKernel kernel;
+
+  /* one marker state per column, rows swept sequentially */
+  c = (int *) RAVE_MALLOC(MAX(domain->width, 1) * sizeof(int));
+  if (c == NULL)
+    fmi_error("propagate_up: memory allocation failed");
+  kernel = propagate_vert_kernel(put_func);
+  if (!propagate_direct(source, domain, target))
+    kernel = NULL;
+  src = NULL;
   for (k = 0; k < domain->channels; k++) {
-    for (i = 0; i < domain->width; i++) {
-      c = 0;
-      for (j = 0; j < domain->height; j++) {
-        if (get_pixel(domain, i, j, k) > 0) {
-          if (c == 0) {
+    for (i = 0; i < domain->width; i++)
+      c[i] = 0;
+    for (j = 0; j < domain->height; j++) {
+      dom = &domain->array[k * domain->area + j * domain->width];
+      if (kernel != NULL) {
+        if (source != NULL)
+          src = &source->array[k * source->area + j * source->width];
+        dst = &target->array[k * target->area + j * target->width];
+        kernel(dom, src, dst, c, domain->width, slope, MAXVAL - 3);
+        continue;
+      }
+      for (i = 0; i < domain->width; i++) {
+        if (dom[i] > 0) {
+          if (c[i] == 0) {
             if (source != NULL) {
-              c = get_pixel(source, i, j, k);
-              if (c == 0)
-                c = 1;
+              c[i] = get_pixel(source, i, j, k); /* geometry may differ from domain */
+              if (c[i] == 0)
+                c[i] = 1;
             } else
-              c = 1;
+              c[i] = 1;
           } else {
-            c = c + slope;
-            if (c > MAXVAL)
-              c = MAXVAL - 3;
-            if (c < 1)
-              c = 1;
+            c[i] = c[i] + slope;
+            if (c[i] > MAXVAL)
+              c[i] = MAXVAL - 3;
+            if (c[i] < 1)
+              c[i] = 1;
           }
         } else
-          c = 0;
-        /* c2=get_pixel(target,i,j,k); c=MAX(c,c2); */
-        put_func(target, i, j, k, (unsigned char) c);
+          c[i] = 0;
+        put_func(target, i, j, k, (unsigned char) c[i]);
       }
     }
   }
+  RAVE_FREE(c);
 }
 
 void propagate_down(FmiImage *source, FmiImage *domain, FmiImage *target,
   signed char slope, void(* put_func)(FmiImage *, int, int, int, Byte))
 {
   register int i, j, k;
-  int c;
-
+  int *c;
+  Byte *dom, *src, *dst;
+  PropagateVertKernel kernel;
+
+  /* one marker state per column, rows swept sequentially */
+  c = (int *) RAVE_MALLOC(MAX(domain->width, 1) * sizeof(int));
+  if (c == NULL)
+    fmi_error("propagate_down: memory allocation failed");
+  kernel = propagate_vert_kernel(put_func);
+  if (!propagate_direct(source, domain, target))
+    kernel = NULL;
+  src = NULL;
   for (k = 0; k < domain->channels; k++) {
-    for (i = 0; i < domain->width; i++) {
-      c = 0;
-      for (j = domain->height - 1; j >= 0; j--) {
-        if (get_pixel(domain, i, j, k) > 0) {
-          if (c == 0) {
+    for (i = 0; i < domain->width; i++)
+      c[i] = 0;
+    for (j = domain->height - 1; j >= 0; j--) {
+      dom = &domain->array[k * domain->area + j * domain->width];
+      if (kernel != NULL) {
+        if (source != NULL)
+          src = &source->array[k * source->area + j * source->width];
+        dst = &target->array[k * target->area + j * target->width];
+        kernel(dom, src, dst, c, domain->width, slope, MAXVAL - 4);
+        continue;
+      }
+      for (i = 0; i < domain->width; i++) {
+        if (dom[i] > 0) {
+          if (c[i] == 0) {
             if (source != NULL) {
-              c = get_pixel(source, i, j, k);
-              if (c == 0)
-                c = 1;
+              c[i] = get_pixel(source, i, j, k); /* geometry may differ from domain */
+              if (c[i] == 0)
+                c[i] = 1;
             } else
-              c = 1;
+              c[i] = 1;
           } else {
-            c = c + slope;
-            if (c > MAXVAL)
-              c = MAXVAL - 4;
-            if (c < 1)
-              c = 1;
+            c[i] = c[i] + slope;
+            if (c[i] > MAXVAL)
+              c[i] = MAXVAL - 4;
+            if (c[i] < 1)
+              c[i] = 1;
           }
         } else
-          c = 0;
-        /*c2=get_pixel(target,i,j,k); 	c=MAX(c,c2); */
-        put_func(target, i, j, k, (unsigned char) c);
+          c[i] = 0;
+        put_func(target, i, j, k, (unsigned char) c[i]);
       }
     }
   }
+  RAVE_FREE(c);
 }
    
 
 
+/* Length of a run as left by the propagate_* passes: saturating at MAXVAL */
+/* and then cycling from the overflow value (MAXVAL-1 horizontally, */
+/* MAXVAL-3 vertically). */
+static Byte seg_length(int length, int overflow)
+{
+  if (length <= MAXVAL)
+    return (Byte) length;
+  return (Byte) (overflow + (length - MAXVAL - 1) % (MAXVAL + 1 - overflow));
+}
+
+Byte horz_seg_length(int length)
+{
+  return seg_length(length, MAXVAL - 1);
+}
+
+/* Single forward scan per row: a run is written only once its end is found, */
+/* so source and target may be the same image. */
 void horz_seg_lengths(FmiImage *source, FmiImage *target)
 {
-  propagate_right(NULL, source, target, 1, put_pixel);
-  if (FMI_DEBUG(5))
-    write_image("debug_horz_seg_lengths_1", target, PGM_RAW);
-  propagate_left(target, source, target, 0, put_pixel);
+  int i, j, k, start;
+  Byte *src, *dst;
+  canonize_image(source, target);
+  for (k = 0; k < source->channels; k++) {
+    for (j = 0; j < source->height; j++) {
+      src = &source->array[k * source->area + j * source->width];
+      dst = &target->array[k * target->area + j * target->width];
+      i = 0;
+      while (i < source->width) {
+        if (src[i] == 0) {
+          dst[i++] = 0;
+          continue;
+        }
+        start = i;
+        while ((i < source->width) && (src[i] > 0))
+          i++;
+        memset(&dst[start], seg_length(i - start, MAXVAL - 1), i - start);
+      }
+    }
+  }
   if (FMI_DEBUG(4))
     write_image("debug_horz_seg_lengths", target, PGM_RAW);
 }
 
+/* Two row sweeps with per-column state: running lengths downwards, then */
+/* the final length of each run copied back upwards. */
 void vert_seg_lengths(FmiImage *source, FmiImage *target)
 {
-  propagate_up(NULL, source, target, 1, put_pixel);
-  if (FMI_DEBUG(5))
-    write_image("debug_vert_seg_lengths_1", target, PGM_RAW);
-  propagate_down(target, source, target, 0, put_pixel);
+  int i, j, k;
+  int *c;
+  Byte *src, *dst;
+  canonize_image(source, target);
+  c = (int *) RAVE_MALLOC(MAX(source->width, 1) * sizeof(int));
+  if (c == NULL)
+    fmi_error("vert_seg_lengths: memory allocation failed");
+  for (k = 0; k < source->channels; k++) {
+    for (i = 0; i < source->width; i++)
+      c[i] = 0;
+    for (j = 0; j < source->height; j++) {
+      src = &source->array[k * source->area + j * source->width];
+      dst = &target->array[k * target->area + j * target->width];
+      for (i = 0; i < source->width; i++) {
+        c[i] = (src[i] > 0) ? c[i] + 1 : 0;
+        if (c[i] > MAXVAL)
+          c[i] = MAXVAL - 3;
+        dst[i] = (Byte) c[i];
+      }
+    }
+    if (FMI_DEBUG(5))
+      write_image("debug_vert_seg_lengths_1", target, PGM_RAW);
+    for (i = 0; i < source->width; i++)
+      c[i] = 0;
+    for (j = source->height - 1; j >= 0; j--) {
+      dst = &target->array[k * target->area + j * target->width];
+      for (i = 0; i < source->width; i++) {
+        if (dst[i] == 0)
+          c[i] = 0;
+        else if (c[i] == 0)
+          c[i] = dst[i];
+        dst[i] = (Byte) c[i];
+      }
+    }
+  }
+  RAVE_FREE(c);
   if (FMI_DEBUG(4))
     write_image("debug_vert_seg_lengths", target, PGM_RAW);
 }
 
-void row_statistics(FmiImage *source, Byte *nonzero, Byte *avg, Byte *pow)
+/* Nonzero count, sum and sum of squares of one row; plain loops over */
+/* contiguous bytes, left for the compiler to vectorize. */
+static void row_reduce(Byte *row, int width, long int *nonzero, long int *sum, long int *sum2)
+{
+  register int i;
+  long int nz = 0, s = 0, s2 = 0;
+  for (i = 0; i < width; i++) {
+    nz += (row[i] > 0);
+    s += row[i];
+    s2 += row[i] * row[i];
+  }
+  *nonzero = nz;
+  *sum = s;
+  *sum2 = s2;
+}
+
+void row_sums(FmiImage *source, long int *nonzero, long int *sum, long int *sum2)
+{
+  register int j;
+  long int nz, s, s2;
+  for (j = 0; j < source->height; j++) {
+    row_reduce(&source->array[j * source->width], source->width, &nz, &s, &s2);
+    if (nonzero != NULL)
+      nonzero[j] = nz;
+    if (sum != NULL)
+      sum[j] = s;
+    if (sum2 != NULL)
+      sum2[j] = s2;
+  }
+}
+
+/* Accumulated row by row, so the image is read sequentially. */
+void col_sums(FmiImage *source, long int *nonzero, long int *sum, long int *sum2)
 {
   register int i, j;
-  int nz, s;
-  long int s2;
-  Byte c;
+  Byte *row;
+  for (i = 0; i < source->width; i++) {
+    if (nonzero != NULL)
+      nonzero[i] = 0;
+    if (sum != NULL)
+      sum[i] = 0;
+    if (sum2 != NULL)
+      sum2[i] = 0;
+  }
   for (j = 0; j < source->height; j++) {
-    nz = 0;
-    s = 0;
-    s2 = 0;
-    for (i = 0; i < source->width; i++) {
-      c = get_pixel(source, i, j, 0);
-      /*nz+=(c>0); */
-      if (c > 0)
-        ++nz;
-      s += c;
-      s2 += c * c;
-    }
+    row = &source->array[j * source->width];
+    if (nonzero != NULL)
+      for (i = 0; i < source->width; i++)
+        nonzero[i] += (row[i] > 0);
+    if (sum != NULL)
+      for (i = 0; i < source->width; i++)
+        sum[i] += row[i];
+    if (sum2 != NULL)
+      for (i = 0; i < source->width; i++)
+        sum2[i] += row[i] * row[i];
+  }
+}
+
+void row_statistics(FmiImage *source, Byte *nonzero, Byte *avg, Byte *pow)
+{
+  register int j;
+  long int nz, s, s2;
+  for (j = 0; j < source->height; j++) {
+    row_reduce(&source->array[j * source->width], source->width, &nz, &s, &s2);
     /*    printf("%d nz=%d s=%d s2=%d (w=%d)\n",j,nz,s,s2,source->width); */
     if (nonzero != NULL)
       nonzero[j] = (255 * nz) / source->width;
@@ -492,26 +863,22 @@ void row_statistics(FmiImage *source, Byte *nonzero, Byte *avg, Byte *pow)
 
 void col_statistics(FmiImage *source, Byte *nonzero, Byte *avg, Byte *pow)
 {
-  register int i, j;
-  int nz, s;
-  long int s2;
-  Byte c;
+  register int i;
+  long int *nz, *s, *s2;
+  nz = (long int *) RAVE_MALLOC(3 * MAX(source->width, 1) * sizeof(long int));
+  if (nz == NULL)
+    fmi_error("col_statistics: memory allocation failed");
+  s = &nz[source->width];
+  s2 = &s[source->width];
+  col_sums(source, nz, s, s2);
   for (i = 0; i < source->width; i++) {
-    nz = 0;
-    s = 0;
-    s2 = 0;
-    for (j = 0; j < source->height; j++) {
-      c = get_pixel(source, i, j, 0);
-      nz += (c > 0);
-      s += c;
-      s2 += c * c;
-    }
     if (nonzero != NULL)
-      nonzero[j] = 255 * nz / source->width;
+      nonzero[i] = 255 * nz[i] / source->height;
     if (avg != NULL)
-      avg[j] = s / source->width;
+      avg[i] = s[i] / source->height;
     if (pow != NULL)
-      pow[j] = sqrt(s2 / source->width);
+      pow[i] = sqrt(s2[i] / source->height);
   }
+  RAVE_FREE(nz);
 }
 
@@ -53,6 +53,8 @@ void iir_left(FmiImage *source,FmiImage *trace,int promille);
 void iir_right(FmiImage *source,FmiImage *trace,int promille);
 void iir_up(FmiImage *source,FmiImage *trace,int promille);
 void iir_down(FmiImage *source,FmiImage *trace,int promille);
+/* max(iir_up,iir_down) in one call */
+void iir_updown(FmiImage *source,FmiImage *trace,int promille);
 
 /* In source, change pixels (i,j) with mask(i,j) < threshold to c */
 void mask_image(FmiImage *source,FmiImage *mask,Byte threshold,Byte c);
@@ -75,7 +77,13 @@ void propagate_up(FmiImage *source,FmiImage *domain,FmiImage *target, signed cha
 void propagate_down(FmiImage *source,FmiImage *domain,FmiImage *target, signed char slope,void (* put_func)(FmiImage *,int,int,int,Byte));
 
 void horz_seg_lengths(FmiImage *source,FmiImage *target);
+/* value written by horz_seg_lengths() over a run of given length */
+Byte horz_seg_length(int length);
 void vert_seg_lengths(FmiImage *source,FmiImage *target);
 
+/* Per-row (height entries) and per-column (width entries) nonzero counts, */
+/* sums and sums of squares of channel 0. NULL outputs are skipped. */
+void row_sums(FmiImage *source,long int *nonzero,long int *sum,long int *sum2);
+void col_sums(FmiImage *source,long int *nonzero,long int *sum,long int *sum2);
 void row_statistics(FmiImage *source,Byte *nonzero,Byte *sum,Byte *sum2);
 void col_statistics(FmiImage *source,Byte *nonzero,Byte *sum,Byte *sum2);
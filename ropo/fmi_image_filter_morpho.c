@@ -23,71 +23,353 @@
 #include "fmi_image.h"
 #include "fmi_image_filter.h"
 #include "fmi_image_histogram.h"
+#include "fmi_image_filter_morpho.h"
 
-void morph_closing(FmiImage *source,FmiImage *target,int w,int h){
+#include <math.h>
+#include <string.h>
+#include "rave_alloc.h"
+
+/* SEPARABLE MORPHOLOGY */
+/* Running max/min of 2*r+1 samples (van Herk / Gil-Werman): */
+/* prefix and suffix extrema within blocks of 2*r+1, */
+/* so the cost per gate is constant regardless of r. */
+/* Gates outside the image are ignored, as with BORDER handling in pipeline_process(). */
+
+#define MORPH_OP(a,b) (is_max ? MAX(a,b) : MIN(a,b))
+
+static void morph_horz(FmiImage *source,FmiImage *target,int hrad,int is_max){
+  register int i,p;
+  int r,k,len;
+  Byte id,v,*line,*g,*h,*out;
+
+  k=2*hrad+1;
+  len=source->width+2*hrad;
+  id=is_max ? 0 : 255;
+  line=(Byte *)RAVE_MALLOC(3*len);
+  if (line==NULL)
+    fmi_error("morph_horz: memory allocation failed");
+  g=line+len;
+  h=g+len;
+
+  memset(line,id,len);
+  for (r=0;r<source->height*source->channels;r++){
+    memcpy(&line[hrad],&source->array[r*source->width],source->width);
+    for (p=0;p<len;p++){
+      v=line[p];
+      g[p]=(p%k==0) ? v : MORPH_OP(g[p-1],v);
+    }
+    for (p=len-1;p>=0;p--){
+      v=line[p];
+      h[p]=((p%k==k-1)||(p==len-1)) ? v : MORPH_OP(h[p+1],v);
+    }
+    out=&target->array[r*source->width];
+    for (i=0;i<source->width;i++)
+      out[i]=MORPH_OP(h[i],g[i+k-1]);
+  }
+  RAVE_FREE(line);
+}
+
+/* Vertical pass sweeping whole rays, so memory is accessed sequentially. */
+static void morph_vert(FmiImage *source,FmiImage *target,int vrad,int is_max,int wrap){
+  register int i;
+  int j,p,c,k,len,width;
+  Byte *g,*h,*pad,*row,*gp,*hp,*out;
+
+  k=2*vrad+1;
+  len=source->height+2*vrad;
+  width=source->width;
+  g=(Byte *)RAVE_MALLOC((2*len+1)*width);
+  if (g==NULL)
+    fmi_error("morph_vert: memory allocation failed");
+  h=g+len*width;
+  pad=h+len*width;
+  memset(pad,is_max ? 0 : 255,width);
+
+  for (c=0;c<source->channels;c++){
+    for (p=0;p<len;p++){
+      j=p-vrad;
+      if (wrap){
+	j=j%source->height;
+	if (j<0) j+=source->height;
+	row=&source->array[c*source->area+j*width];
+      }
+      else
+	row=((j<0)||(j>=source->height)) ? pad : &source->array[c*source->area+j*width];
+      gp=&g[p*width];
+      if (p%k==0)
+	memcpy(gp,row,width);
+      else
+	for (i=0;i<width;i++)
+	  gp[i]=MORPH_OP(gp[i-width],row[i]);
+    }
+    for (p=len-1;p>=0;p--){
+      j=p-vrad;
+      if (wrap){
+	j=j%source->height;
+	if (j<0) j+=source->height;
+	row=&source->array[c*source->area+j*width];
+      }
+      else
+	row=((j<0)||(j>=source->height)) ? pad : &source->array[c*source->area+j*width];
+      hp=&h[p*width];
+      if ((p%k==k-1)||(p==len-1))
+	memcpy(hp,row,width);
+      else
+	for (i=0;i<width;i++)
+	  hp[i]=MORPH_OP(hp[i+width],row[i]);
+    }
+    for (j=0;j<source->height;j++){
+      out=&target->array[c*source->area+j*width];
+      hp=&h[j*width];
+      gp=&g[(j+k-1)*width];
+      for (i=0;i<width;i++)
+	out[i]=MORPH_OP(hp[i],gp[i]);
+    }
+  }
+  RAVE_FREE(g);
+}
+
+static void morph_apply(FmiImage *source,FmiImage *target,FmiMorphElement element,int hrad,int vrad,int wrap,int is_max){
+  register int i;
   FmiImage temp;
-  init_new_image(&temp);
-  canonize_image(source,&temp);
+
   canonize_image(source,target);
-  pipeline_process(source,&temp,w,h,histogram_max);
-  pipeline_process(&temp,target,w,h,histogram_min);
+  hrad=MAX(hrad,0);
+  vrad=MAX(vrad,0);
+  switch (element){
+  case MORPH_RECT:
+    if (hrad>0)
+      morph_horz(source,target,hrad,is_max);
+    else if (source!=target)
+      memcpy(target->array,source->array,source->volume);
+    if (vrad>0)
+      morph_vert(target,target,vrad,is_max,wrap);
+    break;
+  case MORPH_HORZ_LINE:
+    morph_apply(source,target,MORPH_RECT,hrad,0,wrap,is_max);
+    break;
+  case MORPH_VERT_LINE:
+    morph_apply(source,target,MORPH_RECT,0,vrad,wrap,is_max);
+    break;
+  case MORPH_CROSS:
+    init_new_image(&temp);
+    canonize_image(source,&temp);
+    morph_apply(source,&temp,MORPH_RECT,hrad,0,wrap,is_max);
+    morph_apply(source,target,MORPH_RECT,0,vrad,wrap,is_max);
+    for (i=0;i<target->volume;i++)
+      target->array[i]=MORPH_OP(target->array[i],temp.array[i]);
+    reset_image(&temp);
+    break;
+  default:
+    fmi_error("morph: unknown structuring element");
+  }
+}
+
+void morph_dilation(FmiImage *source,FmiImage *target,FmiMorphElement element,int hrad,int vrad,int wrap){
+  morph_apply(source,target,element,hrad,vrad,wrap,1);
+}
+
+void morph_erosion(FmiImage *source,FmiImage *target,FmiMorphElement element,int hrad,int vrad,int wrap){
+  morph_apply(source,target,element,hrad,vrad,wrap,0);
+}
+
+void morph_closing_element(FmiImage *source,FmiImage *target,FmiMorphElement element,int hrad,int vrad,int wrap){
+  morph_apply(source,target,element,hrad,vrad,wrap,1);
+  morph_apply(target,target,element,hrad,vrad,wrap,0);
+}
+
+void morph_opening_element(FmiImage *source,FmiImage *target,FmiMorphElement element,int hrad,int vrad,int wrap){
+  morph_apply(source,target,element,hrad,vrad,wrap,0);
+  morph_apply(target,target,element,hrad,vrad,wrap,1);
+}
+
+void morph_closing(FmiImage *source,FmiImage *target,int w,int h){
+  morph_closing_element(source,target,MORPH_RECT,w,h,0);
   if (FMI_DEBUG(4)) write_image("debug_morph_closing",target,PGM_RAW);
-  reset_image(&temp);
 }
 
 void morph_opening(FmiImage *source,FmiImage *target,int w,int h){
-  FmiImage temp;
-  init_new_image(&temp);
-  canonize_image(source,&temp);
-  canonize_image(source,target);
-  pipeline_process(source,&temp,w,h,histogram_min);
-  pipeline_process(&temp,target,w,h,histogram_max);
-  reset_image(&temp);
+  morph_opening_element(source,target,MORPH_RECT,w,h,0);
 }
 
+/* Decrementing propagation: each gate gets the maximum of its neighbours' values minus one */
+/* (city-block distance). Fast mode; see distance_transform_sq() for exact distances. */
 void distance_transform(FmiImage *source, FmiImage *target)
 {
-  register int i, j, k, s, t;
+  register int i, j, k;
+  int s, t, w;
+  Byte *row, *next;
   if (source != target)
     copy_image(source, target);
 
-  for (j = 0; j < target->height; j++) {
-    for (i = 0; i < target->width; i++) {
-      for (k = 0; k < target->channels; k++) {
-        t = get_pixel(target, i, j, k);
-        s = get_pixel(target, i - 1, j, k);
-        if (s > 0)
-          s--;
-        if (s > t) {
-          put_pixel(target, i, j, k, s);
-          t = s;
+  w = target->width;
+  for (k = 0; k < target->channels; k++) {
+    for (j = 0; j < target->height; j++) {
+      row = &target->array[k * target->area + j * w];
+      for (i = 0; i < w; i++) {
+        t = row[i];
+        if (i > 0) {
+          s = row[i - 1];
+          if (s > 0)
+            s--;
+          if (s > t) {
+            row[i] = s;
+            t = s;
+          }
+        }
+        if (j > 0) {
+          s = row[i - w];
+          if (s > 0)
+            s--;
+          if (s > t)
+            row[i] = s;
         }
-        s = get_pixel(target, i, j - 1, k);
-        if (s > 0)
-          s--;
-        if (s > t)
-          put_pixel(target, i, j, k, s);
       }
     }
   }
 
-  for (j = target->height - 1; j >= 0; j--) {
-    for (i = target->width - 1; i > 0; i--) {
-      for (k = 0; k < target->channels; k++) {
-        t = get_pixel(target, i, j, k);
-        s = get_pixel(target, i + 1, j, k);
-        if (s > 0)
-          s--;
-        if (s > t) {
-          put_pixel(target, i, j, k, s);
-          t = s;
+  for (k = 0; k < target->channels; k++) {
+    for (j = target->height - 1; j >= 0; j--) {
+      row = &target->array[k * target->area + j * w];
+      next = (j < target->height - 1) ? row + w : NULL;
+      for (i = w - 1; i > 0; i--) {
+        t = row[i];
+        if (i < w - 1) {
+          s = row[i + 1];
+          if (s > 0)
+            s--;
+          if (s > t) {
+            row[i] = s;
+            t = s;
+          }
+        }
+        if (next != NULL) {
+          s = next[i];
+          if (s > 0)
+            s--;
+          if (s > t)
+            row[i] = s;
         }
-        s = get_pixel(target, i, j + 1, k);
-        if (s > 0)
-          s--;
-        if (s > t)
-          put_pixel(target, i, j, k, s);
       }
     }
   }
 }
+
+/* 1-D lower envelope of parabolas (Felzenszwalb & Huttenlocher): */
+/* d[p] = min_q f[q] + (pos[p]-pos[q])^2 ; entries f[q]>=HUGE_VAL are skipped. */
+static void distance_envelope_1d(double *f, double *pos, int n, double *d, int *v, double *z)
+{
+  register int p, q;
+  int m;
+  double s;
+
+  m = -1;
+  for (q = 0; q < n; q++) {
+    if (f[q] >= HUGE_VAL)
+      continue;
+    while (m >= 0) {
+      s = ((f[q] + pos[q] * pos[q]) - (f[v[m]] + pos[v[m]] * pos[v[m]])) / (2.0 * (pos[q] - pos[v[m]]));
+      if (s <= z[m])
+        m--;
+      else
+        break;
+    }
+    m++;
+    v[m] = q;
+    z[m] = (m == 0) ? -HUGE_VAL : s;
+  }
+
+  if (m < 0) {
+    for (p = 0; p < n; p++)
+      d[p] = HUGE_VAL;
+    return;
+  }
+  z[m + 1] = HUGE_VAL;
+
+  q = 0;
+  for (p = 0; p < n; p++) {
+    while (z[q + 1] < pos[p])
+      q++;
+    s = pos[p] - pos[v[q]];
+    d[p] = s * s + f[v[q]];
+  }
+}
+
+void distance_transform_sq(FmiImage *source, double *dist2, double range_step, double azimuth_step, int wrap)
+{
+  register int i, j;
+  int k, n, len, last;
+  double a, *f, *pos, *d, *z, *row;
+  int *v;
+  Byte *src;
+
+  n = source->height;
+  len = wrap ? 3 * n : n;
+  f = (double *) RAVE_MALLOC((4 * len + 2) * sizeof(double));
+  v = (int *) RAVE_MALLOC((len + 1) * sizeof(int));
+  if ((f == NULL) || (v == NULL))
+    fmi_error("distance_transform_sq: memory allocation failed");
+  pos = f + len;
+  d = pos + len;
+  z = d + len;
+
+  for (k = 0; k < source->channels; k++) {
+
+    /* ALONG RAYS: distance to the nearest gate in the same ray */
+    for (j = 0; j < n; j++) {
+      src = &source->array[k * source->area + j * source->width];
+      row = &dist2[k * source->area + j * source->width];
+      last = -1;
+      for (i = 0; i < source->width; i++) {
+        if (src[i] > 0)
+          last = i;
+        row[i] = (last < 0) ? HUGE_VAL : (i - last) * range_step;
+      }
+      last = -1;
+      for (i = source->width - 1; i >= 0; i--) {
+        if (src[i] > 0)
+          last = i;
+        if ((last >= 0) && ((last - i) * range_step < row[i]))
+          row[i] = (last - i) * range_step;
+        if (row[i] < HUGE_VAL)
+          row[i] *= row[i];
+      }
+    }
+
+    /* ACROSS RAYS: lower envelope per bin, with the arc length at the bin's range */
+    /* in polar mode (azimuth_step<=0) */
+    for (i = 0; i < source->width; i++) {
+      a = (azimuth_step > 0.0) ? azimuth_step : 2.0 * PI * (i + 0.5) * range_step / n;
+      for (j = 0; j < len; j++) {
+        f[j] = dist2[k * source->area + (j % n) * source->width + i];
+        pos[j] = a * j;
+      }
+      distance_envelope_1d(f, pos, len, d, v, z);
+      for (j = 0; j < n; j++)
+        dist2[k * source->area + j * source->width + i] = d[wrap ? j + n : j];
+    }
+  }
+  RAVE_FREE(f);
+  RAVE_FREE(v);
+}
+
+void distance_transform_euclidean(FmiImage *source, FmiImage *target, double range_step, double azimuth_step, double unit, int wrap)
+{
+  register int i;
+  double *dist2, d;
+
+  canonize_image(source, target);
+  dist2 = (double *) RAVE_MALLOC(source->volume * sizeof(double));
+  if (dist2 == NULL)
+    fmi_error("distance_transform_euclidean: memory allocation failed");
+  distance_transform_sq(source, dist2, range_step, azimuth_step, wrap);
+  for (i = 0; i < source->volume; i++) {
+    if (dist2[i] >= HUGE_VAL)
+      target->array[i] = 255;
+    else {
+      d = sqrt(dist2[i]) / unit + 0.5;
+      target->array[i] = (d >= 255.0) ? 255 : (Byte) d;
+    }
+  }
+  RAVE_FREE(dist2);
+}
@@ -21,8 +21,38 @@
 
 
 
+#ifndef __FMI_IMAGE_FILTER_MORPHO__
+#define __FMI_IMAGE_FILTER_MORPHO__
+
+#include "fmi_image.h"
+
+/* Structuring elements; half-widths hrad (along ray) and vrad (across rays) */
+typedef enum {
+  MORPH_RECT,      /* (2*hrad+1)x(2*vrad+1) rectangle */
+  MORPH_HORZ_LINE, /* 2*hrad+1 gates along the ray */
+  MORPH_VERT_LINE, /* 2*vrad+1 gates across rays */
+  MORPH_CROSS      /* union of the two lines */
+} FmiMorphElement;
+
 void distance_transform(FmiImage *source,FmiImage *target);
 
+/* Exact squared Euclidean distance to the nearest gate with source>0, in linear time. */
+/* Gate spacing is range_step along rays and azimuth_step across rays (e.g. metres); */
+/* if azimuth_step<=0, the arc length at the range of each bin is used (polar grid). */
+/* dist2 has source->volume entries; HUGE_VAL where no gate is set. */
+void distance_transform_sq(FmiImage *source,double *dist2,double range_step,double azimuth_step,int wrap);
+/* As above, written as round(distance/unit) saturated to 255. */
+void distance_transform_euclidean(FmiImage *source,FmiImage *target,double range_step,double azimuth_step,double unit,int wrap);
+
 void morph_closing(FmiImage *source,FmiImage *target,int w,int h);
 
 void morph_opening(FmiImage *source,FmiImage *target,int w,int h);
+
+/* Separable max/min filters, constant cost per gate. Target may equal source. */
+/* If wrap is nonzero, the first and last rays are neighbours (full 360 degree sweep). */
+void morph_dilation(FmiImage *source,FmiImage *target,FmiMorphElement element,int hrad,int vrad,int wrap);
+void morph_erosion(FmiImage *source,FmiImage *target,FmiMorphElement element,int hrad,int vrad,int wrap);
+void morph_closing_element(FmiImage *source,FmiImage *target,FmiMorphElement element,int hrad,int vrad,int wrap);
+void morph_opening_element(FmiImage *source,FmiImage *target,FmiMorphElement element,int hrad,int vrad,int wrap);
+
+#endif
@@ -25,6 +25,7 @@
 #include "fmi_image_filter.h"
 #include "fmi_image_histogram.h"
 #include "fmi_image_filter_speck.h"
+#include "fmi_image_rle.h"
 
 /* THIS IS THE GOOD OLD BINARY PROBE */
 
@@ -38,6 +39,9 @@ FmiImage *PROBE_SOURCE;
 FmiImage *PROBE_TARGET;
 FmiImage PROBE_BOOK[1]; 
 
+/* nonzero: ray 0 and ray height-1 are neighbours (full azimuth sweep) */
+int PROBE_WRAP;
+
 /**
  * So that we keep track on if the probe book is initialized properly or not
  */
@@ -65,6 +69,15 @@ int ROT_CODE(int i,int j){
 } 
 
 
+/* ray index mapped back into the image in azimuth-wrapping mode */
+static int probe_ray(int j){
+  if (PROBE_WRAP){
+    j=j%PROBE_DOMAIN->height;
+    if (j<0) j+=PROBE_DOMAIN->height;
+  }
+  return j;
+}
+
 /* trace = book keeping image */
 
 /* subroutine: process single speck */
@@ -72,10 +85,11 @@ int ROT_CODE(int i,int j){
 /*void probe_speck(FmiImage *domain,FmiImage *trace,int i,int j,unsigned char min_value){ */
 void probe_speck(int i,int j,unsigned char min_value){
   /* ,int *area,int histogram[256],int *perimeter){ */
-  int dir;
+  int dir,jj;
   static unsigned char g;
 
-  if (!legal_coords(PROBE_DOMAIN,i,j)){          /* OUTSIDE IMAGE  */
+  jj=probe_ray(j);
+  if (!legal_coords(PROBE_DOMAIN,i,jj)){          /* OUTSIDE IMAGE  */
     PROBE_SPECK_HISTOGRAM[HIST_SIZE]++;
     PROBE_SPECK_HISTOGRAM[HIST_PERIMx3]+=3;
     PROBE_SPECK_HISTOGRAM[HIST_SUM_I]+=i;
@@ -85,7 +99,7 @@ void probe_speck(int i,int j,unsigned char min_value){
     PROBE_SPECK_HISTOGRAM[HIST_SUM_IJ]+=i*j;
     return;}
 
-  if ((g=get_pixel(PROBE_DOMAIN,i,j,0))<min_value){    /* OUTSIDE SPECK  */
+  if ((g=get_pixel(PROBE_DOMAIN,i,jj,0))<min_value){    /* OUTSIDE SPECK  */
     PROBE_SPECK_HISTOGRAM[HIST_SIZE]++;
     PROBE_SPECK_HISTOGRAM[HIST_PERIMx3]+=3;
     PROBE_SPECK_HISTOGRAM[HIST_SUM_I]+=i;
@@ -95,13 +109,13 @@ void probe_speck(int i,int j,unsigned char min_value){
     PROBE_SPECK_HISTOGRAM[HIST_SUM_IJ]+=i*j;
     return;}
 
-  if (get_pixel(PROBE_TARGET,i,j,0)!=UNVISITED)   /* ALREADY MARKED */
+  if (get_pixel(PROBE_TARGET,i,jj,0)!=UNVISITED)   /* ALREADY MARKED */
     return; 
 
-  put_pixel(PROBE_TARGET,i,j,0,VISITED);
+  put_pixel(PROBE_TARGET,i,jj,0,VISITED);
   /*  ++(*area);   */
   PROBE_SPECK_HISTOGRAM[HIST_AREA]++;
-  g=get_pixel(PROBE_SOURCE,i,j,0);
+  g=get_pixel(PROBE_SOURCE,i,jj,0);
   PROBE_SPECK_HISTOGRAM[g]++;
   if (g<PROBE_SPECK_HISTOGRAM[HIST_MIN])
     PROBE_SPECK_HISTOGRAM[HIST_MIN]=g;
@@ -118,7 +132,7 @@ void probe_speck(int i,int j,unsigned char min_value){
   /*  if (histogram[HIST_SUM_II]>(INT_MAX/16)) */
   /*  printf("SUM_II=%d\n",histogram[HIST_SUM_II]); */
 
-  dir=ROT_CODE(i,j);
+  dir=ROT_CODE(i,jj);
   probe_speck(i+ROTX(dir  ),j+ROTY(dir  ),min_value);
   probe_speck(i+ROTX(dir+1),j+ROTY(dir+1),min_value);
   probe_speck(i+ROTX(dir+2),j+ROTY(dir+2),min_value);
@@ -130,6 +144,7 @@ void probe_speck(int i,int j,unsigned char min_value){
 /*void propagate_attribute(FmiImage *domain,FmiImage *trace,int i,int j,unsigned char min_value,unsigned char attribute){ */
 void propagate_attribute(int i,int j,unsigned char min_value,unsigned char attribute){
   int dir;
+  j=probe_ray(j);
   if (!legal_coords(PROBE_DOMAIN,i,j))    return; /* OUTSIDE IMAGE  */
   if (get_pixel(PROBE_DOMAIN,i,j,0)<min_value)  return; /* OUTSIDE SPECK  */
   if (get_pixel(PROBE_BOOK, i,j,0)==DONE) return;
@@ -210,13 +225,45 @@ void traverse_image(int i,int j,int min_value){
 
 /* CLIENT (STARTER) */
 void Binaryprobe(FmiImage *domain,FmiImage *source,FmiImage *trace,int (* histogram_function)(Histogram),unsigned char min_value){ 
+  Binaryprobe_wrap(domain,source,trace,histogram_function,min_value,0);
+}
+
+/* Area-only probe: the speck area is its number of gates, so labelling */
+/* the run-length encoded domain gives the same trace as the recursion. */
+static int probe_area_only(FmiImage *domain,FmiImage *source,int (* histogram_function)(Histogram),unsigned char min_value){
+  if (histogram_function!=histogram_area) return 0;
+  if (histogram_scaling_function!=NULL) return 0;
+  if (min_value==0) return 0;
+  if (domain->channels!=1) return 0;
+  return ((domain->width==source->width)&&(domain->height==source->height));
+}
+
+static void probe_areas_rle(FmiImage *domain,FmiImage *trace,unsigned char min_value,int wrap){
+  FmiRle rle;
+  init_new_rle(&rle);
+  image_to_rle(domain,&rle,min_value-1);
+  label_rle(&rle,wrap);
+  rle_component_areas(&rle,trace);
+  reset_rle(&rle);
+}
+
+void Binaryprobe_wrap(FmiImage *domain,FmiImage *source,FmiImage *trace,int (* histogram_function)(Histogram),unsigned char min_value,int wrap){ 
   register int i,j;
   fmi_debug(3,"filter_specks");
   if (source->channels!=1) 
     fmi_error("filter_specks: other than single-channel source");
+
+  if (probe_area_only(domain,source,histogram_function,min_value)){
+    canonize_image(source,trace);
+    probe_areas_rle(domain,trace,min_value,wrap);
+    fmi_debug(4,"filter_specks, DONE.");
+    return;
+  }
+
   PROBE_DOMAIN=domain;
   PROBE_SOURCE=source;
   PROBE_TARGET=trace;
+  PROBE_WRAP=wrap;
 
   if (probe_book_initialized == 0) {
     init_new_image(PROBE_BOOK);
@@ -250,6 +297,10 @@ void detect_specks(FmiImage *source,FmiImage *trace,unsigned char min_value,int
   Binaryprobe(source,source,trace,histogram_function,min_value);
 }
 
+void detect_specks_wrap(FmiImage *source,FmiImage *trace,unsigned char min_value,int (* histogram_function)(Histogram),int wrap){ 
+  Binaryprobe_wrap(source,source,trace,histogram_function,min_value,wrap);
+}
+
 /* DEBUGGING... */
 void test_rotation(FmiImage *target,FmiImage *trace,int i,int j,int rec_depth){
   int dir=1;
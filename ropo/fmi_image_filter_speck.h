@@ -27,6 +27,10 @@
 /* Remove specks with area up to A pixels    */
 void detect_specks(FmiImage *target,FmiImage *trace,unsigned char min_value,int (* histogram_function)(Histogram));
 void Binaryprobe(FmiImage *domain,FmiImage *source,FmiImage *target,int (* histogram_function)(Histogram),unsigned char min_value);
+
+/* As above; if wrap is nonzero, the first and last rays are connected (full 360 degree sweep) */
+void detect_specks_wrap(FmiImage *target,FmiImage *trace,unsigned char min_value,int (* histogram_function)(Histogram),int wrap);
+void Binaryprobe_wrap(FmiImage *domain,FmiImage *source,FmiImage *target,int (* histogram_function)(Histogram),unsigned char min_value,int wrap);
 /*void remove_specks(FmiImage *img,Byte min_intensity,int max_property,Byte marker,int (* histogram_function)(Histogram)); */
 
 /* debugging and development */
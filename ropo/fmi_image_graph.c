@@ -0,0 +1,340 @@
+/**
+
+    Copyright 2001 - 2010  Markus Peura,
+    Finnish Meteorological Institute (First.Last@fmi.fi)
+
+
+    This file is part of bRopo.
+
+    bRopo is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    bRopo is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser Public License for more details.
+
+    You should have received a copy of the GNU Lesser Public License
+    along with bRopo.  If not, see <http://www.gnu.org/licenses/>. */
+
+
+
+#include <string.h>
+#include "fmi_util.h"
+#include "fmi_image.h"
+#include "fmi_image_histogram.h"
+#include "fmi_image_graph.h"
+
+void init_image_graph(FmiImageGraph *graph,FmiImage *source){
+  graph->source=source;
+  graph->node_count=0;
+}
+
+static FmiGraphNode *graph_new_node(FmiImageGraph *graph,FmiGraphNodeType type,char *name,int input,int input2){
+  FmiGraphNode *node;
+  int edge=graph->node_count+1;
+  if (graph->node_count>=FMI_GRAPH_MAX_NODES)
+    fmi_error("graph: too many nodes");
+  if ((input<0)||(input>=edge)||(input2>=edge))
+    fmi_error("graph: input edge not defined yet");
+  node=&graph->node[graph->node_count++];
+  memset(node,0,sizeof(FmiGraphNode));
+  node->type=type;
+  node->name=name;
+  node->input[0]=input;
+  node->input[1]=input2;
+  node->radius=(type==GRAPH_OP)?FMI_GRAPH_GLOBAL:0;
+  return node;
+}
+
+int graph_op(FmiImageGraph *graph,char *name,FmiGraphOp op,int input,int input2){
+  FmiGraphNode *node=graph_new_node(graph,GRAPH_OP,name,input,input2);
+  node->op=op;
+  return graph->node_count;
+}
+
+int graph_lut(FmiImageGraph *graph,char *name,int input,Byte *lut){
+  FmiGraphNode *node=graph_new_node(graph,GRAPH_LUT,name,input,FMI_GRAPH_NONE);
+  memcpy(node->lut,lut,256);
+  node->lut_active=1;
+  return graph->node_count;
+}
+
+int graph_binary(FmiImageGraph *graph,char *name,FmiGraphNodeType type,int input,int input2){
+  if ((type==GRAPH_OP)||(type==GRAPH_LUT)||(input2<0))
+    fmi_error("graph_binary: not a binary element-wise node");
+  graph_new_node(graph,type,name,input,input2);
+  return graph->node_count;
+}
+
+int graph_threshold(FmiImageGraph *graph,char *name,int input,Byte threshold){
+  Byte lut[256];
+  int i;
+  for (i=0;i<256;i++)
+    lut[i]=(i>threshold)?i:0;
+  return graph_lut(graph,name,input,lut);
+}
+
+int graph_scale255(FmiImageGraph *graph,char *name,int input,int coeff){
+  Byte lut[256];
+  int i,temp;
+  for (i=0;i<256;i++){
+    temp=i*coeff/255;
+    lut[i]=MIN(temp,255);}
+  return graph_lut(graph,name,input,lut);
+}
+
+static void graph_pipeline_op(FmiImage **input,FmiImage *target,FmiGraphNode *node){
+  pipeline_process(input[0],target,node->param[0],node->param[1],node->histogram_function);
+}
+
+int graph_pipeline(FmiImageGraph *graph,char *name,int input,int horz_rad,int vert_rad,int (* histogram_function)(Histogram)){
+  int edge=graph_op(graph,name,graph_pipeline_op,input,FMI_GRAPH_NONE);
+  FmiGraphNode *node=graph_node(graph,edge);
+  node->param[0]=horz_rad;
+  node->param[1]=vert_rad;
+  node->histogram_function=histogram_function;
+  node->radius=vert_rad;
+  return edge;
+}
+
+FmiGraphNode *graph_node(FmiImageGraph *graph,int edge){
+  if ((edge<1)||(edge>graph->node_count))
+    fmi_error("graph_node: no node produces this edge");
+  return &graph->node[edge-1];
+}
+
+static void graph_elementwise(FmiGraphNode *node,FmiImage **input,FmiImage *target){
+  register int i;
+  int g;
+  Byte *a=input[0]->array;
+  Byte *b=(input[1]!=NULL)?input[1]->array:NULL;
+  Byte *t=target->array;
+
+  for (i=0;i<target->volume;i++){
+    switch (node->type){
+    case GRAPH_MAX:
+      g=(a[i]>b[i]) ? a[i] : b[i];
+      break;
+    case GRAPH_MIN:
+      g=(a[i]<b[i]) ? a[i] : b[i];
+      break;
+    case GRAPH_SUBTRACT:
+      g=(a[i]>b[i]) ? a[i]-b[i] : 0;
+      break;
+    case GRAPH_AVERAGE:
+      g=(a[i]+b[i])/2;
+      g=(g<=254 ? g : 254);
+      break;
+    default:
+      g=a[i];
+    }
+    t[i]=node->lut_active ? node->lut[g] : (Byte)g;
+  }
+}
+
+/* Intermediate results are bytes only; nothing in the chain reads the originals. */
+static void graph_byte_buffer(FmiImage *sample,FmiImage *buffer){
+  init_new_image(buffer);
+  copy_image_properties(sample,buffer);
+  initialize_byte_image(buffer);
+}
+
+void graph_execute(FmiImageGraph *graph,int output,FmiImage *target){
+  FmiGraphNode plan[FMI_GRAPH_MAX_NODES];
+  FmiImage buffer[FMI_GRAPH_MAX_NODES];
+  FmiImage *input[2];
+  FmiImage *out;
+  int needed[FMI_GRAPH_MAX_NODES];
+  int alias[FMI_GRAPH_MAX_NODES+1];      /* edge -> edge actually computed */
+  int consumers[FMI_GRAPH_MAX_NODES+1];
+  int last_use[FMI_GRAPH_MAX_NODES+1];
+  int edge_buffer[FMI_GRAPH_MAX_NODES+1];
+  int buffer_free[FMI_GRAPH_MAX_NODES];
+  int buffer_count=0;
+  int count=graph->node_count;
+  int n,m,e,i,x,b;
+
+  if ((output<0)||(output>count))
+    fmi_error("graph_execute: undefined output edge");
+  canonize_image(graph->source,target);
+  if (output==FMI_GRAPH_SOURCE){
+    copy_image(graph->source,target);
+    return;
+  }
+  memcpy(plan,graph->node,count*sizeof(FmiGraphNode));
+
+  /* only the nodes the output depends on */
+  for (n=0;n<count;n++)
+    needed[n]=0;
+  needed[output-1]=1;
+  for (n=count-1;n>=0;n--)
+    if (needed[n])
+      for (i=0;i<2;i++)
+	if (plan[n].input[i]>0)
+	  needed[plan[n].input[i]-1]=1;
+
+  for (e=0;e<=count;e++){
+    alias[e]=e;
+    consumers[e]=0;
+    last_use[e]=-1;
+    edge_buffer[e]=-1;
+  }
+  for (n=0;n<count;n++)
+    if (needed[n])
+      for (i=0;i<2;i++)
+	if (plan[n].input[i]>=0)
+	  consumers[plan[n].input[i]]++;
+
+  /* fold lookup tables into the element-wise node they read from */
+  for (n=0;n<count;n++){
+    if (!needed[n]||(plan[n].type!=GRAPH_LUT))
+      continue;
+    e=plan[n].input[0];
+    if ((e==FMI_GRAPH_SOURCE)||(consumers[e]!=1))
+      continue;
+    m=alias[e]-1;
+    if (plan[m].type==GRAPH_OP)
+      continue;
+    for (x=0;x<256;x++)
+      plan[m].lut[x]=plan[n].lut[plan[m].lut_active ? plan[m].lut[x] : x];
+    plan[m].lut_active=1;
+    alias[n+1]=alias[e];
+    needed[n]=0;
+  }
+
+  for (n=0;n<count;n++)
+    if (needed[n])
+      for (i=0;i<2;i++)
+	if (plan[n].input[i]>=0)
+	  last_use[alias[plan[n].input[i]]]=n;
+
+  for (n=0;n<count;n++){
+    if (!needed[n])
+      continue;
+    for (i=0;i<2;i++){
+      e=plan[n].input[i];
+      if (e<0)
+	input[i]=NULL;
+      else if (alias[e]==FMI_GRAPH_SOURCE)
+	input[i]=graph->source;
+      else
+	input[i]=&buffer[edge_buffer[alias[e]]];
+    }
+
+    /* choose the output buffer */
+    e=n+1;
+    if (alias[output]==e)
+      out=target;
+    else {
+      b=-1;
+      if (plan[n].type!=GRAPH_OP)
+	for (i=0;i<2;i++){
+	  x=plan[n].input[i];
+	  if ((x>0)&&(last_use[alias[x]]==n)&&(edge_buffer[alias[x]]>=0)){
+	    b=edge_buffer[alias[x]];
+	    edge_buffer[alias[x]]=-1;
+	    break;
+	  }
+	}
+      for (i=0;(b<0)&&(i<buffer_count);i++)
+	if (buffer_free[i])
+	  b=i;
+      if (b<0){
+	b=buffer_count++;
+	graph_byte_buffer(graph->source,&buffer[b]);
+      }
+      buffer_free[b]=0;
+      edge_buffer[e]=b;
+      out=&buffer[b];
+    }
+
+    if (plan[n].type==GRAPH_OP)
+      plan[n].op(input,out,&plan[n]);
+    else
+      graph_elementwise(&plan[n],input,out);
+    if ((plan[n].name!=NULL)&&FMI_DEBUG(4))
+      write_image(plan[n].name,out,PGM_RAW);
+
+    /* release inputs that are not read again */
+    for (i=0;i<2;i++){
+      x=plan[n].input[i];
+      if ((x>0)&&(last_use[alias[x]]==n)&&(edge_buffer[alias[x]]>=0)){
+	buffer_free[edge_buffer[alias[x]]]=1;
+	edge_buffer[alias[x]]=-1;
+      }
+    }
+  }
+
+  for (b=0;b<buffer_count;b++)
+    reset_image(&buffer[b]);
+}
+
+/* Rows [row,row+rows) of a single-channel image, sharing its arrays. */
+static void graph_strip_view(FmiImage *image,int row,int rows,FmiImage *view){
+  *view=*image;
+  view->height=rows;
+  view->area=view->width*rows;
+  view->volume=view->area;
+  view->array=&image->array[row*image->width];
+  if (image->original!=NULL)
+    view->original=&image->original[row*image->width];
+}
+
+void graph_execute_tiled(FmiImageGraph *graph,int output,FmiImage *target,int tile_rows){
+  FmiImageGraph strip_graph;
+  FmiImage view;
+  FmiImage strip;
+  FmiImage *source=graph->source;
+  int needed[FMI_GRAPH_MAX_NODES];
+  int n,i,halo,row,first,last;
+  int width=source->width;
+
+  if ((output<=0)||(output>graph->node_count)||(source->channels!=1)
+      ||(source->coord_overflow_handler_y!=BORDER)){
+    graph_execute(graph,output,target);
+    return;
+  }
+
+  /* reach of the chain: sum of the radii of the needed nodes */
+  for (n=0;n<graph->node_count;n++)
+    needed[n]=0;
+  needed[output-1]=1;
+  halo=0;
+  for (n=graph->node_count-1;n>=0;n--){
+    if (!needed[n])
+      continue;
+    if (graph->node[n].radius<0){
+      graph_execute(graph,output,target);
+      return;
+    }
+    halo+=graph->node[n].radius;
+    for (i=0;i<2;i++)
+      if (graph->node[n].input[i]>0)
+	needed[graph->node[n].input[i]-1]=1;
+  }
+
+  if (tile_rows<=0)
+    tile_rows=FMI_GRAPH_TILE_BYTES/(MAX(width,1)*(graph->node_count+1));
+  tile_rows=MAX(tile_rows,MAX(halo,1));
+  if (tile_rows>=source->height){
+    graph_execute(graph,output,target);
+    return;
+  }
+
+  canonize_image(source,target);
+  for (row=0;row<source->height;row+=tile_rows){
+    first=MAX(row-halo,0);
+    last=MIN(row+tile_rows+halo,source->height);
+    strip_graph=*graph;
+    graph_strip_view(source,first,last-first,&view);
+    strip_graph.source=&view;
+    graph_byte_buffer(&view,&strip);
+    graph_execute(&strip_graph,output,&strip);
+    memcpy(&target->array[row*width],&strip.array[(row-first)*width],
+	   MIN(tile_rows,source->height-row)*width);
+    reset_image(&strip);
+  }
+}
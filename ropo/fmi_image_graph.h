@@ -0,0 +1,119 @@
+/**
+
+    Copyright 2001 - 2010  Markus Peura,
+    Finnish Meteorological Institute (First.Last@fmi.fi)
+
+
+    This file is part of bRopo.
+
+    bRopo is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    bRopo is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser Public License for more details.
+
+    You should have received a copy of the GNU Lesser Public License
+    along with bRopo.  If not, see <http://www.gnu.org/licenses/>. */
+
+
+
+
+
+#ifndef __FMI_IMAGE_GRAPH__
+#define __FMI_IMAGE_GRAPH__
+
+#include "fmi_image.h"
+#include "fmi_image_histogram.h"
+
+/* DETECTOR DATAFLOW GRAPHS */
+/* A detector is described as a list of nodes, each reading one or two */
+/* earlier images (edges) and producing one new image. Edge 0 is the */
+/* source image; the output of node n is edge n+1, so nodes are always */
+/* added in a valid execution order. */
+/* */
+/* graph_execute() evaluates only the nodes the requested output depends on, */
+/* folds chains of element-wise nodes into single lookup tables, and keeps */
+/* intermediate images only while they are still needed: released buffers */
+/* are reused by later nodes, and element-wise nodes overwrite inputs that */
+/* are not read again. */
+/* */
+/* graph_execute_tiled() evaluates the graph strip by strip (groups of rays) */
+/* so that the intermediate images stay in cache. Each node declares its */
+/* vertical reach (radius); a strip is extended by the sum of the radii of */
+/* the needed nodes, and only its inner rows are kept. Graphs containing */
+/* nodes of unbounded reach (FMI_GRAPH_GLOBAL, the default of graph_op) */
+/* are executed untiled. */
+
+#define FMI_GRAPH_MAX_NODES 32
+#define FMI_GRAPH_SOURCE 0
+#define FMI_GRAPH_NONE -1
+#define FMI_GRAPH_GLOBAL -1
+
+/* cache budget for the strips of graph_execute_tiled() */
+#define FMI_GRAPH_TILE_BYTES (256*1024)
+
+typedef enum {
+  GRAPH_OP,         /* general operator */
+  GRAPH_LUT,        /* target = lut[source] */
+  GRAPH_MAX,        /* max_image() */
+  GRAPH_MIN,        /* min_image() */
+  GRAPH_SUBTRACT,   /* subtract_image() */
+  GRAPH_AVERAGE     /* average_images() */
+} FmiGraphNodeType;
+
+struct fmi_graph_node;
+
+/* A general operator must write every pixel of target, which may hold */
+/* data left by an earlier node. input[1] is NULL for unary nodes. */
+typedef void (* FmiGraphOp)(FmiImage **input,FmiImage *target,struct fmi_graph_node *node);
+
+struct fmi_graph_node {
+  FmiGraphNodeType type;
+  char *name;     /* debug image name, or NULL */
+  FmiGraphOp op;
+  int input[2];
+  int radius;           /* rows read above and below, or FMI_GRAPH_GLOBAL */
+  int param[4];
+  int (* histogram_function)(Histogram);
+  int lut_active;       /* element-wise nodes: lut applied to the result */
+  Byte lut[256];
+};
+
+typedef struct fmi_graph_node FmiGraphNode;
+
+struct fmi_image_graph {
+  FmiImage *source;
+  int node_count;
+  FmiGraphNode node[FMI_GRAPH_MAX_NODES];
+};
+
+typedef struct fmi_image_graph FmiImageGraph;
+
+void init_image_graph(FmiImageGraph *graph,FmiImage *source);
+
+/* Node constructors return the edge holding the result. */
+int graph_op(FmiImageGraph *graph,char *name,FmiGraphOp op,int input,int input2);
+int graph_lut(FmiImageGraph *graph,char *name,int input,Byte *lut);
+int graph_binary(FmiImageGraph *graph,char *name,FmiGraphNodeType type,int input,int input2);
+/* As threshold_image(). */
+int graph_threshold(FmiImageGraph *graph,char *name,int input,Byte threshold);
+/* As multiply_image_scalar255(). */
+int graph_scale255(FmiImageGraph *graph,char *name,int input,int coeff);
+/* As pipeline_process(), with radius vert_rad; the histogram function */
+/* must not depend on the pixel position. */
+int graph_pipeline(FmiImageGraph *graph,char *name,int input,int horz_rad,int vert_rad,int (* histogram_function)(Histogram));
+
+/* Node producing the given edge, for setting param[]. */
+FmiGraphNode *graph_node(FmiImageGraph *graph,int edge);
+
+/* Computes edge output into target (canonized to the source). */
+void graph_execute(FmiImageGraph *graph,int output,FmiImage *target);
+/* Same result as graph_execute(). tile_rows <= 0 selects a strip height */
+/* from FMI_GRAPH_TILE_BYTES. */
+void graph_execute_tiled(FmiImageGraph *graph,int output,FmiImage *target,int tile_rows);
+
+#endif
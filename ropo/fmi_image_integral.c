@@ -0,0 +1,217 @@
+/**
+
+    Copyright 2001 - 2010  Markus Peura,
+    Finnish Meteorological Institute (First.Last@fmi.fi)
+
+
+    This file is part of bRopo.
+
+    bRopo is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    bRopo is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser Public License for more details.
+
+    You should have received a copy of the GNU Lesser Public License
+    along with bRopo.  If not, see <http://www.gnu.org/licenses/>. */
+
+
+
+
+
+#include "fmi_util.h"
+#include "fmi_image.h"
+#include "fmi_image_integral.h"
+#include "rave_alloc.h"
+
+/* A box edge range split into ranges inside the image, each read */
+/* weight times. */
+struct integral_range {
+  int n;
+  int lo[3], hi[3];
+  long int weight[3];
+};
+
+static void integral_range_add(struct integral_range *range,int lo,int hi,long int weight){
+  if ((lo>hi)||(weight<=0))
+    return;
+  range->lo[range->n]=lo;
+  range->hi[range->n]=hi;
+  range->weight[range->n]=weight;
+  range->n++;
+}
+
+static void integral_range(struct integral_range *range,int a,int b,int size,CoordOverflowHandler handler){
+  int length, start;
+  range->n=0;
+  if (a>b)
+    return;
+  switch (handler){
+  case BORDER:
+    integral_range_add(range,MAX(a,0),MIN(b,size-1),1);
+    if (a<0)
+      integral_range_add(range,0,0,MIN(b,-1)-a+1);
+    if (b>=size)
+      integral_range_add(range,size-1,size-1,b-MAX(a,size)+1);
+    break;
+  case WRAP:
+  case TILE:
+    length=b-a+1;
+    start=((a%size)+size)%size;
+    integral_range_add(range,0,size-1,length/size);
+    length=length%size;
+    integral_range_add(range,start,MIN(start+length-1,size-1),1);
+    integral_range_add(range,0,start+length-1-size,1);
+    break;
+  default:
+    integral_range_add(range,MAX(a,0),MIN(b,size-1),1);
+  }
+}
+
+void init_integral_image(FmiIntegralImage *integral,FmiImage *source,int azimuth_wrap){
+  int i, j, w1;
+  long int row_sum, row_count, row_original_count;
+  double row_original_sum, value;
+  Byte *src;
+
+  integral->width=source->width;
+  integral->height=source->height;
+  integral->handler_x=source->coord_overflow_handler_x;
+  integral->handler_y=azimuth_wrap ? TILE : source->coord_overflow_handler_y;
+  integral->azimuth_wrap=azimuth_wrap;
+  integral->original_undetect=source->original_undetect;
+
+  w1=source->width+1;
+  integral->sum=(long int *)RAVE_MALLOC(w1*(source->height+1)*sizeof(long int));
+  integral->count=(long int *)RAVE_MALLOC(w1*(source->height+1)*sizeof(long int));
+  integral->original_sum=(double *)RAVE_MALLOC(w1*(source->height+1)*sizeof(double));
+  integral->original_count=(long int *)RAVE_MALLOC(w1*(source->height+1)*sizeof(long int));
+  if ((integral->sum==NULL)||(integral->count==NULL)||
+      (integral->original_sum==NULL)||(integral->original_count==NULL))
+    fmi_error("init_integral_image: memory allocation failed");
+
+  for (i=0;i<w1;i++){
+    integral->sum[i]=0;
+    integral->count[i]=0;
+    integral->original_sum[i]=0.0;
+    integral->original_count[i]=0;
+  }
+
+  for (j=0;j<source->height;j++){
+    long int *sum=&integral->sum[(j+1)*w1];
+    long int *count=&integral->count[(j+1)*w1];
+    double *original_sum=&integral->original_sum[(j+1)*w1];
+    long int *original_count=&integral->original_count[(j+1)*w1];
+    double *original=&source->original[j*source->width];
+    src=&source->array[j*source->width];
+    row_sum=row_count=row_original_count=0;
+    row_original_sum=0.0;
+    sum[0]=count[0]=original_count[0]=0;
+    original_sum[0]=0.0;
+    for (i=0;i<source->width;i++){
+      row_sum+=src[i];
+      row_count+=(src[i]>0);
+      value=original[i];
+      if (value!=source->original_undetect){
+        row_original_sum+=value;
+        row_original_count++;
+      }
+      sum[i+1]=sum[i+1-w1]+row_sum;
+      count[i+1]=count[i+1-w1]+row_count;
+      original_sum[i+1]=original_sum[i+1-w1]+row_original_sum;
+      original_count[i+1]=original_count[i+1-w1]+row_original_count;
+    }
+  }
+}
+
+void reset_integral_image(FmiIntegralImage *integral){
+  RAVE_FREE(integral->sum);
+  RAVE_FREE(integral->count);
+  RAVE_FREE(integral->original_sum);
+  RAVE_FREE(integral->original_count);
+}
+
+/* Total of table over the inclusive box, all inside the image. */
+#define INTEGRAL_RECT(table,w1,x0,y0,x1,y1) \
+  ((table)[((y1)+1)*(w1)+(x1)+1]-(table)[(y0)*(w1)+(x1)+1]-(table)[((y1)+1)*(w1)+(x0)]+(table)[(y0)*(w1)+(x0)])
+
+static long int integral_query(FmiIntegralImage *integral,long int *table,int x0,int y0,int x1,int y1){
+  struct integral_range rx, ry;
+  int i, j;
+  long int result=0;
+  integral_range(&rx,x0,x1,integral->width,integral->handler_x);
+  integral_range(&ry,y0,y1,integral->height,integral->handler_y);
+  for (j=0;j<ry.n;j++)
+    for (i=0;i<rx.n;i++)
+      result+=rx.weight[i]*ry.weight[j]*
+	(table==NULL ? (long int)(rx.hi[i]-rx.lo[i]+1)*(ry.hi[j]-ry.lo[j]+1) :
+	 INTEGRAL_RECT(table,integral->width+1,rx.lo[i],ry.lo[j],rx.hi[i],ry.hi[j]));
+  return result;
+}
+
+/* Original-domain ranges: inside the image only, wrapping in azimuth. */
+static void integral_original_ranges(FmiIntegralImage *integral,struct integral_range *rx,struct integral_range *ry,int x0,int y0,int x1,int y1){
+  integral_range(rx,x0,x1,integral->width,ZERO);
+  integral_range(ry,y0,y1,integral->height,integral->azimuth_wrap ? TILE : ZERO);
+}
+
+long int integral_box_area(FmiIntegralImage *integral,int x0,int y0,int x1,int y1){
+  return integral_query(integral,NULL,x0,y0,x1,y1);
+}
+
+long int integral_box_sum(FmiIntegralImage *integral,int x0,int y0,int x1,int y1){
+  return integral_query(integral,integral->sum,x0,y0,x1,y1);
+}
+
+long int integral_box_count(FmiIntegralImage *integral,int x0,int y0,int x1,int y1){
+  return integral_query(integral,integral->count,x0,y0,x1,y1);
+}
+
+Byte integral_box_mean(FmiIntegralImage *integral,int x0,int y0,int x1,int y1){
+  long int area=integral_box_area(integral,x0,y0,x1,y1);
+  if (area==0)
+    return 0;
+  return integral_box_sum(integral,x0,y0,x1,y1)/area;
+}
+
+Byte integral_box_mean_nonzero(FmiIntegralImage *integral,int x0,int y0,int x1,int y1){
+  long int count=integral_box_count(integral,x0,y0,x1,y1);
+  if (count==0)
+    return 0;
+  return integral_box_sum(integral,x0,y0,x1,y1)/count;
+}
+
+long int integral_original_count(FmiIntegralImage *integral,int x0,int y0,int x1,int y1){
+  struct integral_range rx, ry;
+  int i, j;
+  long int result=0;
+  integral_original_ranges(integral,&rx,&ry,x0,y0,x1,y1);
+  for (j=0;j<ry.n;j++)
+    for (i=0;i<rx.n;i++)
+      result+=rx.weight[i]*ry.weight[j]*
+	INTEGRAL_RECT(integral->original_count,integral->width+1,rx.lo[i],ry.lo[j],rx.hi[i],ry.hi[j]);
+  return result;
+}
+
+double integral_original_sum(FmiIntegralImage *integral,int x0,int y0,int x1,int y1){
+  struct integral_range rx, ry;
+  int i, j;
+  double result=0.0;
+  integral_original_ranges(integral,&rx,&ry,x0,y0,x1,y1);
+  for (j=0;j<ry.n;j++)
+    for (i=0;i<rx.n;i++)
+      result+=rx.weight[i]*ry.weight[j]*
+	INTEGRAL_RECT(integral->original_sum,integral->width+1,rx.lo[i],ry.lo[j],rx.hi[i],ry.hi[j]);
+  return result;
+}
+
+double integral_original_mean(FmiIntegralImage *integral,int x0,int y0,int x1,int y1){
+  long int count=integral_original_count(integral,x0,y0,x1,y1);
+  if (count==0)
+    return integral->original_undetect;
+  return integral_original_sum(integral,x0,y0,x1,y1)/(double)count;
+}
@@ -0,0 +1,79 @@
+/**
+
+    Copyright 2001 - 2010  Markus Peura,
+    Finnish Meteorological Institute (First.Last@fmi.fi)
+
+
+    This file is part of bRopo.
+
+    bRopo is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    bRopo is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser Public License for more details.
+
+    You should have received a copy of the GNU Lesser Public License
+    along with bRopo.  If not, see <http://www.gnu.org/licenses/>. */
+
+
+
+
+
+#ifndef __FMI_IMAGE_INTEGRAL__
+#define __FMI_IMAGE_INTEGRAL__
+
+#include "fmi_image.h"
+
+/* SUMMED-AREA TABLES (INTEGRAL IMAGES) */
+/* Each table holds, at (x,y), the total over the gates left of x and */
+/* above y of channel 0, so the total over any box is obtained from four */
+/* entries regardless of the box size. */
+/* */
+/* Byte queries follow the coordinate overflow handlers of the source: */
+/* BORDER repeats the edge gates (as get_pixel() and pipeline_process() */
+/* do), WRAP and TILE wrap around, and other handlers ignore the gates */
+/* outside the image. Original-domain queries count only gates inside */
+/* the image whose value differs from original_undetect, as */
+/* restore_image2() does. With azimuth_wrap, the first and last ray are */
+/* neighbours in all queries. */
+/* */
+/* Boxes are given as inclusive corners x0<=x1, y0<=y1, and may extend */
+/* outside the image. */
+
+struct fmi_integral_image {
+  int width;
+  int height;
+  CoordOverflowHandler handler_x, handler_y;
+  int azimuth_wrap;
+  long int *sum;             /* bytes */
+  long int *count;           /* nonzero bytes */
+  double *original_sum;      /* original values other than undetect */
+  long int *original_count;  /* original values other than undetect */
+  double original_undetect;
+};
+
+typedef struct fmi_integral_image FmiIntegralImage;
+
+void init_integral_image(FmiIntegralImage *integral,FmiImage *source,int azimuth_wrap);
+void reset_integral_image(FmiIntegralImage *integral);
+
+/* Number of gates in the box, edge gates counted as often as they are read. */
+long int integral_box_area(FmiIntegralImage *integral,int x0,int y0,int x1,int y1);
+long int integral_box_sum(FmiIntegralImage *integral,int x0,int y0,int x1,int y1);
+/* Number of nonzero bytes. */
+long int integral_box_count(FmiIntegralImage *integral,int x0,int y0,int x1,int y1);
+/* Mean over all gates of the box. */
+Byte integral_box_mean(FmiIntegralImage *integral,int x0,int y0,int x1,int y1);
+/* Mean of the nonzero bytes, as histogram_mean_nonzero(); 0 if none. */
+Byte integral_box_mean_nonzero(FmiIntegralImage *integral,int x0,int y0,int x1,int y1);
+
+long int integral_original_count(FmiIntegralImage *integral,int x0,int y0,int x1,int y1);
+double integral_original_sum(FmiIntegralImage *integral,int x0,int y0,int x1,int y1);
+/* Mean of the detected original values; original_undetect if none. */
+double integral_original_mean(FmiIntegralImage *integral,int x0,int y0,int x1,int y1);
+
+#endif
@@ -19,9 +19,13 @@
     You should have received a copy of the GNU Lesser Public License
     along with bRopo.  If not, see <http://www.gnu.org/licenses/>. */
 
+#include <string.h>
 #include "fmi_image_restore.h"
 #include "fmi_image_filter.h"
 #include "fmi_image_histogram.h"
+#include "fmi_image_integral.h"
+#include "fmi_util.h"
+#include "rave_alloc.h"
 
 
 void mark_image(FmiImage *target,FmiImage *prob,Byte threshold,Byte marker){ 
@@ -63,6 +67,43 @@ void restore_image_neg(FmiImage *source,FmiImage *target,FmiImage *prob,Byte thr
       target->array[i]=source->array[i];
 }
 
+void restore_image_thresholds(FmiImage *source,FmiImage **targets,FmiImage *prob,Byte *thresholds,int count,long int *removed,long int *detected){
+  register int i, k;
+  long int n_detected=0;
+  Byte s, p;
+  double o;
+
+  canonize_image(source,prob);
+  for (k=0;k<count;k++){
+    canonize_image(source,targets[k]);
+    if (removed!=NULL)
+      removed[k]=0;
+  }
+
+  for (i=0;i<prob->volume;i++){
+    s=source->array[i];
+    o=source->original[i];
+    p=prob->array[i];
+    if (s>0)
+      n_detected++;
+    for (k=0;k<count;k++){
+      if (p>=thresholds[k]){
+	targets[k]->array[i]=0;
+	targets[k]->original[i]=targets[k]->original_undetect;
+	if ((s>0)&&(removed!=NULL))
+	  removed[k]++;
+      }
+      else {
+	targets[k]->array[i]=s;
+	targets[k]->original[i]=o;
+      }
+    }
+  }
+
+  if (detected!=NULL)
+    *detected=n_detected;
+}
+
 static double calculate_original_mean(FmiImage* source, int x, int y, int hrad, int vrad)
 {
   int h,v;
@@ -85,54 +126,275 @@ static double calculate_original_mean(FmiImage* source, int x, int y, int hrad,
   return source->original_undetect;
 }
 
-static void process_original_mean(FmiImage* source, FmiImage* target, int hrad, int vrad)
+/* Mean of the nonzero bytes in the (2*hrad+1)x(2*vrad+1) window, as */
+/* computed by pipeline_process() with histogram_mean_nonzero(). */
+static Byte calculate_mean_nonzero(FmiImage* source, int x, int y, int hrad, int vrad)
 {
-  int x, y;
-  for (x = 0; x < source->width; x++) {
-    for (y = 0; y < source->height; y++) {
-      put_pixel_orig(target, x, y, 0, calculate_original_mean(source, x, y, hrad, vrad));
+  int h, v, k;
+  int sum = 0, count = 0;
+  Byte c, *row;
+  if (source->channels == 1 && x - hrad >= 0 && x + hrad < source->width &&
+      y - vrad >= 0 && y + vrad < source->height) {
+    for (v = y - vrad; v <= y + vrad; v++) {
+      row = &source->array[v * source->width];
+      for (h = x - hrad; h <= x + hrad; h++) {
+        if (row[h] > 0) {
+          sum += row[h];
+          count++;
+        }
+      }
+    }
+  } else {
+    /* near the edges, the window follows the coordinate overflow handling */
+    for (k = 0; k < source->channels; k++) {
+      for (h = x - hrad; h <= x + hrad; h++) {
+        for (v = y - vrad; v <= y + vrad; v++) {
+          c = get_pixel(source, h, v, k);
+          if (c > 0) {
+            sum += c;
+            count++;
+          }
+        }
+      }
     }
   }
+  return (count > 0) ? sum / count : 0;
 }
 
 /* other */
 void restore_image2(FmiImage *source,FmiImage *target,FmiImage *prob,Byte threshold){ 
-  register int i;
-  FmiImage median;
-  FmiImage original_mean;
-  init_new_image(&median);
-  init_new_image(&original_mean);
+  register int i, n;
+  int x, y, count;
+  int *gate;
+  FmiIntegralImage integral;
+  Byte *byte_mean;
+  double *original_mean;
 
   canonize_image(source,prob);
   canonize_image(source,target);
-  canonize_image(source,&median);
-  canonize_image(source,&original_mean);
 
-  /* ERASE ANOMALIES (to black) */
+  /* ERASE ANOMALIES (to black), COLLECTING THE ERASED GATES */
+  count = 0;
   for (i=0; i < prob->volume; i++) {
     if (prob->array[i] >= threshold) {
       target->array[i] = 0;
       target->original[i] = target->original_undetect;
+      count++;
     } else {
       target->array[i] = source->array[i];
       target->original[i] = source->original[i];
     }
   }
+  if (count == 0)
+    return;
 
-  /* CALCULATE ME(DI)AN OF NONZERO PIXELS */
-  pipeline_process(target, &median, 2, 2, histogram_mean_nonzero); /* Affects the 8-bit version */
+  gate = (int *) RAVE_MALLOC(count * sizeof(int));
+  byte_mean = (Byte *) RAVE_MALLOC(count * sizeof(Byte));
+  original_mean = (double *) RAVE_MALLOC(count * sizeof(double));
+  if (gate == NULL || byte_mean == NULL || original_mean == NULL)
+    fmi_error("restore_image2: memory allocation failed");
+  n = 0;
+  for (i=0; i < prob->volume; i++)
+    if (prob->array[i] >= threshold)
+      gate[n++] = i;
 
-  process_original_mean(target, &original_mean, 2, 2); /* And the original data */
+  /* CALCULATE ME(DI)AN OF NONZERO PIXELS, ONLY AT THE ERASED GATES */
+  /* (all means are taken from the erased image before any gate is filled) */
+  if (target->channels == 1 && count * 8 > target->area) {
+    /* many gates: summed-area tables answer each window in constant time */
+    init_integral_image(&integral, target, 0);
+    for (n=0; n < count; n++) {
+      x = gate[n] % target->width;
+      y = gate[n] / target->width;
+      byte_mean[n] = integral_box_mean_nonzero(&integral, x-2, y-2, x+2, y+2);
+      original_mean[n] = integral_original_mean(&integral, x-2, y-2, x+2, y+2);
+    }
+    reset_integral_image(&integral);
+  } else {
+    for (n=0; n < count; n++) {
+      i = gate[n] % target->area;
+      byte_mean[n] = calculate_mean_nonzero(target, i % target->width, i / target->width, 2, 2); /* Affects the 8-bit version */
+      original_mean[n] = calculate_original_mean(target, i % target->width, i / target->width, 2, 2); /* And the original data */
+    }
+  }
 
   /* REPLACE ANOMALOUS PIXELS WITH THAT NEIGHBORHOOD ME(DI)AN */
-  for (i = 0; i < prob->volume; i++){
-    if (prob->array[i] >= threshold) {
-      target->array[i] = median.array[i];
-      target->original[i] = original_mean.original[i];
+  for (n=0; n < count; n++) {
+    target->array[gate[n]] = byte_mean[n];
+    target->original[gate[n]] = original_mean[n];
+  }
+
+  RAVE_FREE(gate);
+  RAVE_FREE(byte_mean);
+  RAVE_FREE(original_mean);
+}
+
+/* PYRAMID RESTORE */
+/* Per block: sums of the detected values and their counts in both */
+/* domains, and the number of unflagged gates. Once a level is complete, */
+/* the sums and counts are normalized by the unflagged count. */
+#define PYRAMID_SUM 0
+#define PYRAMID_COUNT 1
+#define PYRAMID_ORIGINAL_SUM 2
+#define PYRAMID_ORIGINAL_COUNT 3
+#define PYRAMID_VALID 4
+#define PYRAMID_FIELDS 5
+#define PYRAMID_MAX_LEVELS 32
+
+struct restore_level {
+  int width;
+  int height;
+  double *cell;   /* PYRAMID_FIELDS values per block */
+};
+
+static void pyramid_alloc(struct restore_level *level,int width,int height){
+  level->width=width;
+  level->height=height;
+  level->cell=(double *)RAVE_MALLOC(width*height*PYRAMID_FIELDS*sizeof(double));
+  if (level->cell==NULL)
+    fmi_error("restore_image_pyramid: memory allocation failed");
+  memset(level->cell,0,width*height*PYRAMID_FIELDS*sizeof(double));
+}
+
+/* Divides the sums and counts of the nonempty blocks by their unflagged count. */
+static void pyramid_normalize(struct restore_level *level){
+  int i, k;
+  double *c;
+  for (i=0;i<level->width*level->height;i++){
+    c=&level->cell[i*PYRAMID_FIELDS];
+    if (c[PYRAMID_VALID]>0){
+      for (k=0;k<PYRAMID_VALID;k++)
+	c[k]/=c[PYRAMID_VALID];
+      c[PYRAMID_VALID]=1.0;
     }
   }
+}
+
+/* Bilinear interpolation of the normalized parent level at child block (x,y). */
+/* Returns 0 if all contributing parent blocks are empty. */
+static int pyramid_interpolate(struct restore_level *parent,int x,int y,int azimuth_wrap,double *result){
+  int px[2], py[2];
+  double wx[2], wy[2], w, weight=0.0;
+  double *c;
+  int i, j, k;
+
+  px[0]=x>>1;
+  px[1]=(x&1) ? px[0]+1 : px[0]-1;
+  if ((px[1]<0)||(px[1]>=parent->width))
+    px[1]=px[0];
+  py[0]=y>>1;
+  py[1]=(y&1) ? py[0]+1 : py[0]-1;
+  if ((py[1]<0)||(py[1]>=parent->height))
+    py[1]=azimuth_wrap ? (py[1]+parent->height)%parent->height : py[0];
+  wx[0]=wy[0]=0.75;
+  wx[1]=wy[1]=0.25;
 
-  reset_image(&median);
-  reset_image(&original_mean);
+  for (k=0;k<PYRAMID_VALID;k++)
+    result[k]=0.0;
+  for (j=0;j<2;j++)
+    for (i=0;i<2;i++){
+      c=&parent->cell[(py[j]*parent->width+px[i])*PYRAMID_FIELDS];
+      if (c[PYRAMID_VALID]>0){
+	w=wx[i]*wy[j];
+	for (k=0;k<PYRAMID_VALID;k++)
+	  result[k]+=w*c[k];
+	weight+=w;
+      }
+    }
+  if (weight==0.0)
+    return 0;
+  for (k=0;k<PYRAMID_VALID;k++)
+    result[k]/=weight;
+  return 1;
 }
 
+void restore_image_pyramid(FmiImage *source,FmiImage *target,FmiImage *prob,Byte threshold,int azimuth_wrap){
+  struct restore_level level[PYRAMID_MAX_LEVELS];
+  int levels, holes;
+  int i, j, k, l, x, y;
+  double *c, *p, value[PYRAMID_VALID];
+  Byte *row, *prob_row;
+  double *orig_row;
+  struct restore_level *child, *parent;
+
+  restore_image(source,target,prob,threshold);
+
+  /* LEVEL 1: 2x2 BLOCKS OF THE UNFLAGGED GATES (channel 0) */
+  pyramid_alloc(&level[0],(target->width+1)/2,(target->height+1)/2);
+  for (j=0;j<target->height;j++){
+    row=&target->array[j*target->width];
+    orig_row=&target->original[j*target->width];
+    prob_row=&prob->array[j*target->width];
+    c=&level[0].cell[(j>>1)*level[0].width*PYRAMID_FIELDS];
+    for (i=0;i<target->width;i++){
+      if (prob_row[i]<threshold){
+	p=&c[(i>>1)*PYRAMID_FIELDS];
+	p[PYRAMID_VALID]+=1.0;
+	if (row[i]>0){
+	  p[PYRAMID_SUM]+=row[i];
+	  p[PYRAMID_COUNT]+=1.0;
+	}
+	if (orig_row[i]!=target->original_undetect){
+	  p[PYRAMID_ORIGINAL_SUM]+=orig_row[i];
+	  p[PYRAMID_ORIGINAL_COUNT]+=1.0;
+	}
+      }
+    }
+  }
+
+  /* PULL: COARSER LEVELS UNTIL NO BLOCK IS EMPTY */
+  levels=1;
+  while (1){
+    child=&level[levels-1];
+    holes=0;
+    for (i=0;i<child->width*child->height;i++)
+      if (child->cell[i*PYRAMID_FIELDS+PYRAMID_VALID]==0){
+	holes=1;
+	break;
+      }
+    if ((!holes)||((child->width==1)&&(child->height==1))||(levels==PYRAMID_MAX_LEVELS))
+      break;
+    parent=&level[levels];
+    pyramid_alloc(parent,(child->width+1)/2,(child->height+1)/2);
+    for (y=0;y<child->height;y++)
+      for (x=0;x<child->width;x++){
+	c=&child->cell[(y*child->width+x)*PYRAMID_FIELDS];
+	p=&parent->cell[((y>>1)*parent->width+(x>>1))*PYRAMID_FIELDS];
+	for (k=0;k<PYRAMID_FIELDS;k++)
+	  p[k]+=c[k];
+      }
+    levels++;
+  }
+
+  /* PUSH: FILL EMPTY BLOCKS FROM THE COARSER LEVEL */
+  pyramid_normalize(&level[levels-1]);
+  for (l=levels-2;l>=0;l--){
+    child=&level[l];
+    pyramid_normalize(child);
+    for (y=0;y<child->height;y++)
+      for (x=0;x<child->width;x++){
+	c=&child->cell[(y*child->width+x)*PYRAMID_FIELDS];
+	if ((c[PYRAMID_VALID]==0)&&pyramid_interpolate(&level[l+1],x,y,azimuth_wrap,c))
+	  c[PYRAMID_VALID]=1.0;
+      }
+  }
+
+  /* FILL THE FLAGGED GATES FROM LEVEL 1 */
+  for (j=0;j<target->height;j++){
+    prob_row=&prob->array[j*target->width];
+    for (i=0;i<target->width;i++){
+      if (prob_row[i]<threshold)
+	continue;
+      if (!pyramid_interpolate(&level[0],i,j,azimuth_wrap,value))
+	continue;
+      k=j*target->width+i;
+      if ((value[PYRAMID_COUNT]>0)&&(value[PYRAMID_COUNT]>=0.5))
+	target->array[k]=(Byte)MIN(value[PYRAMID_SUM]/value[PYRAMID_COUNT]+0.5,255);
+      if ((value[PYRAMID_ORIGINAL_COUNT]>0)&&(value[PYRAMID_ORIGINAL_COUNT]>=0.5))
+	target->original[k]=value[PYRAMID_ORIGINAL_SUM]/value[PYRAMID_ORIGINAL_COUNT];
+    }
+  }
+
+  for (l=0;l<levels;l++)
+    RAVE_FREE(level[l].cell);
+}
@@ -33,4 +33,19 @@ void restore_image(FmiImage *source,FmiImage *target,FmiImage *prob,Byte thresho
 void restore_image_neg(FmiImage *source,FmiImage *target,FmiImage *prob,Byte threshold);
 void restore_image2(FmiImage *source,FmiImage *target,FmiImage *prob,Byte threshold);
 
+/* As restore_image() for several thresholds in one pass: targets[k] is */
+/* restored with thresholds[k]. If removed is not NULL, removed[k] is set */
+/* to the number of detected (nonzero) gates erased from targets[k]; if */
+/* detected is not NULL, it is set to the number of detected gates. */
+void restore_image_thresholds(FmiImage *source,FmiImage **targets,FmiImage *prob,Byte *thresholds,int count,long int *removed,long int *detected);
+
+/* Fills anomalies of any size by push-pull interpolation over an image */
+/* pyramid: the unflagged data is averaged down by 2x2 blocks until no */
+/* block is empty, and empty blocks are then interpolated bilinearly from */
+/* the coarser level on the way back up. A filled gate gets the mean of */
+/* the detected data if most of the data around it is detected, otherwise */
+/* undetect; byte and original data are handled separately. With */
+/* azimuth_wrap, the first and last ray are neighbours. */
+void restore_image_pyramid(FmiImage *source,FmiImage *target,FmiImage *prob,Byte threshold,int azimuth_wrap);
+
 #endif
@@ -0,0 +1,222 @@
+/**
+
+    Copyright 2001 - 2010  Markus Peura,
+    Finnish Meteorological Institute (First.Last@fmi.fi)
+
+
+    This file is part of bRopo.
+
+    bRopo is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    bRopo is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser Public License for more details.
+
+    You should have received a copy of the GNU Lesser Public License
+    along with bRopo.  If not, see <http://www.gnu.org/licenses/>. */
+
+#include <stdlib.h>
+#include <string.h>
+#include "fmi_util.h"
+#include "fmi_image.h"
+#include "fmi_image_rle.h"
+#include "rave_alloc.h"
+
+#define MAXVAL 250
+
+void init_new_rle(FmiRle *rle){
+  rle->width=0;
+  rle->height=0;
+  rle->channels=0;
+  rle->run_count=0;
+  rle->row_start=NULL;
+  rle->run_x=NULL;
+  rle->run_length=NULL;
+  rle->run_label=NULL;
+  rle->label_count=0;
+}
+
+void reset_rle(FmiRle *rle){
+  RAVE_FREE(rle->row_start);
+  RAVE_FREE(rle->run_x);
+  RAVE_FREE(rle->run_length);
+  RAVE_FREE(rle->run_label);
+  init_new_rle(rle);
+}
+
+void image_to_rle(FmiImage *source,FmiRle *rle,Byte threshold){
+  register int i,r;
+  int rows,runs,inside;
+  Byte *p;
+
+  rows=source->height*source->channels;
+
+  /* first pass: count runs, to allocate exactly once */
+  runs=0;
+  for (r=0;r<rows;r++){
+    p=&source->array[r*source->width];
+    inside=0;
+    for (i=0;i<source->width;i++){
+      if (p[i]>threshold){
+	if (!inside) ++runs;
+	inside=1;
+      }
+      else
+	inside=0;
+    }
+  }
+
+  reset_rle(rle);
+  rle->row_start=(int *)RAVE_MALLOC((rows+1)*sizeof(int));
+  rle->run_x=(int *)RAVE_MALLOC(MAX(runs,1)*sizeof(int));
+  rle->run_length=(int *)RAVE_MALLOC(MAX(runs,1)*sizeof(int));
+  if ((rle->row_start==NULL)||(rle->run_x==NULL)||(rle->run_length==NULL))
+    fmi_error("image_to_rle: memory allocation failed");
+  rle->width=source->width;
+  rle->height=source->height;
+  rle->channels=source->channels;
+  rle->run_count=runs;
+
+  /* second pass: store runs */
+  runs=0;
+  for (r=0;r<rows;r++){
+    rle->row_start[r]=runs;
+    p=&source->array[r*source->width];
+    i=0;
+    while (i<source->width){
+      if (p[i]>threshold){
+	rle->run_x[runs]=i;
+	while ((i<source->width)&&(p[i]>threshold))
+	  i++;
+	rle->run_length[runs]=i-rle->run_x[runs];
+	runs++;
+      }
+      else
+	i++;
+    }
+  }
+  rle->row_start[rows]=runs;
+}
+
+static void rle_canonize_image(FmiRle *rle,FmiImage *target){
+  if (target->type==NULL_IMAGE){
+    target->width=rle->width;
+    target->height=rle->height;
+    target->channels=rle->channels;
+    initialize_image(target);
+  }
+  else if ((target->width!=rle->width)||(target->height!=rle->height)||(target->channels!=rle->channels))
+    fmi_error("rle: incompatible image geometry");
+}
+
+static int rle_find(int *parent,int i){
+  int root;
+  root=i;
+  while (parent[root]!=root)
+    root=parent[root];
+  while (parent[i]!=root){
+    int next=parent[i];
+    parent[i]=root;
+    i=next;
+  }
+  return root;
+}
+
+static void rle_union(int *parent,int a,int b){
+  a=rle_find(parent,a);
+  b=rle_find(parent,b);
+  if (a<b)
+    parent[b]=a;
+  else if (b<a)
+    parent[a]=b;
+}
+
+/* join overlapping runs of rows ra and rb (4-connectivity) */
+static void rle_join_rows(FmiRle *rle,int *parent,int ra,int rb){
+  register int a,b;
+  int a_end,b_end;
+  a=rle->row_start[ra];
+  a_end=rle->row_start[ra+1];
+  b=rle->row_start[rb];
+  b_end=rle->row_start[rb+1];
+  while ((a<a_end)&&(b<b_end)){
+    if ((rle->run_x[a]<rle->run_x[b]+rle->run_length[b])&&
+	(rle->run_x[b]<rle->run_x[a]+rle->run_length[a]))
+      rle_union(parent,a,b);
+    /* advance the run that ends first */
+    if (rle->run_x[a]+rle->run_length[a]<rle->run_x[b]+rle->run_length[b])
+      a++;
+    else
+      b++;
+  }
+}
+
+int label_rle(FmiRle *rle,int wrap){
+  register int a,b,r;
+  int k;
+  int *parent;
+
+  RAVE_FREE(rle->run_label);
+  rle->label_count=0;
+  if (rle->run_count==0)
+    return 0;
+
+  parent=(int *)RAVE_MALLOC(rle->run_count*sizeof(int));
+  if (parent==NULL)
+    fmi_error("label_rle: memory allocation failed");
+  for (a=0;a<rle->run_count;a++)
+    parent[a]=a;
+
+  for (k=0;k<rle->channels;k++){
+    for (r=k*rle->height+1;r<(k+1)*rle->height;r++)
+      rle_join_rows(rle,parent,r-1,r);
+    if ((wrap)&&(rle->height>2))
+      rle_join_rows(rle,parent,k*rle->height,(k+1)*rle->height-1);
+  }
+
+  rle->run_label=(int *)RAVE_MALLOC(rle->run_count*sizeof(int));
+  if (rle->run_label==NULL)
+    fmi_error("label_rle: memory allocation failed");
+
+  /* roots precede their members, so labels come out in raster order */
+  for (a=0;a<rle->run_count;a++){
+    b=rle_find(parent,a);
+    if (b==a)
+      rle->run_label[a]=rle->label_count++;
+    else
+      rle->run_label[a]=rle->run_label[b];
+  }
+  RAVE_FREE(parent);
+  return rle->label_count;
+}
+
+void rle_component_areas(FmiRle *rle,FmiImage *target){
+  register int i,r;
+  long int *area;
+  Byte *p;
+
+  if (rle->run_label==NULL)
+    label_rle(rle,0);
+  rle_canonize_image(rle,target);
+  memset(target->array,0,target->volume);
+  if (rle->label_count==0)
+    return;
+
+  area=(long int *)RAVE_MALLOC(rle->label_count*sizeof(long int));
+  if (area==NULL)
+    fmi_error("rle_component_areas: memory allocation failed");
+  memset(area,0,rle->label_count*sizeof(long int));
+  for (i=0;i<rle->run_count;i++)
+    area[rle->run_label[i]]+=rle->run_length[i];
+
+  for (r=0;r<rle->height*rle->channels;r++){
+    p=&target->array[r*rle->width];
+    for (i=rle->row_start[r];i<rle->row_start[r+1];i++)
+      memset(&p[rle->run_x[i]],(Byte)MIN(area[rle->run_label[i]],MAXVAL),rle->run_length[i]);
+  }
+  RAVE_FREE(area);
+}
@@ -0,0 +1,63 @@
+/**
+
+    Copyright 2001 - 2010  Markus Peura,
+    Finnish Meteorological Institute (First.Last@fmi.fi)
+
+
+    This file is part of bRopo.
+
+    bRopo is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    bRopo is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser Public License for more details.
+
+    You should have received a copy of the GNU Lesser Public License
+    along with bRopo.  If not, see <http://www.gnu.org/licenses/>. */
+
+
+
+#ifndef __FMI_IMAGE_RLE__
+#define __FMI_IMAGE_RLE__
+
+#include "fmi_image.h"
+
+/* RUN-LENGTH ENCODED BINARY IMAGES */
+/* A thresholded image is stored as runs of consecutive gates along each ray. */
+/* Runs of row j (channel k) are run_x[i],run_length[i] for */
+/* row_start[k*height+j] <= i < row_start[k*height+j+1]. */
+/* Operations below cost work proportional to the number of runs, */
+/* which is small for sparse (clear-air) scans. */
+
+struct fmi_rle {
+  int width,height,channels;
+  int run_count;
+  int *row_start;   /* height*channels+1 entries */
+  int *run_x;       /* first gate of run */
+  int *run_length;  /* gates in run */
+  int *run_label;   /* component label of run, see label_rle() */
+  int label_count;
+};
+
+typedef struct fmi_rle FmiRle;
+
+void init_new_rle(FmiRle *rle);
+void reset_rle(FmiRle *rle);
+
+/* Encode gates with source > threshold. */
+void image_to_rle(FmiImage *source,FmiRle *rle,Byte threshold);
+
+/* 4-connected component labelling of runs. Returns the number of components; */
+/* labels 0..label_count-1 are stored in run_label. If wrap is nonzero, */
+/* the first and last rays are connected (full 360 degree sweep). */
+int label_rle(FmiRle *rle,int wrap);
+
+/* Write the area of each component (saturated to 250) to its gates. */
+/* Labels without wrap unless label_rle() has been called already. */
+void rle_component_areas(FmiRle *rle,FmiImage *target);
+
+#endif
@@ -23,13 +23,16 @@
 #include <math.h>
 #include <limits.h>
 #include <stdlib.h>
+#include <string.h>
 #include "fmi_util.h"
 #include "fmi_image.h"
 #include "fmi_image_arith.h"
 #include "fmi_image_filter.h"
 #include "fmi_image_filter_morpho.h"
+#include "fmi_image_bits.h"
 #include "fmi_image_filter_line.h"
 #include "fmi_image_histogram.h"
+#include "fmi_image_graph.h"
 #include "fmi_image_filter_speck.h"
 #include "fmi_meteosat.h"
 #include "fmi_radar_image.h"
@@ -288,43 +291,57 @@ void dump_sweep_info(void){
 void enhance_horz(FmiImage *trace){
   register int i, j, k;
   int m, c;
-  int *n;
-  n = (int*) RAVE_MALLOC(trace->height*sizeof(int));
-  /* int m[trace->height]; */
+  int n_first, n_last, n_prev, n_cur, n_next;
+  Byte *row;
+  /* row counts are kept for the previous, current and next row only; */
+  /* the first and last rows are counted before they are modified */
   for (k = 0; k < trace->channels; k++) {
+    row = &trace->array[k * trace->area];
+    n_first = 0;
+    for (i = 0; i < trace->width; i++)
+      n_first += (row[i] > 0);
+    row = &trace->array[k * trace->area + (trace->height - 1) * trace->width];
+    n_last = 0;
+    for (i = 0; i < trace->width; i++)
+      n_last += (row[i] > 0);
+    n_prev = n_last;
+    n_cur = n_first;
     for (j = 0; j < trace->height; j++) {
-      n[j] = 0;
-      for (i = 0; i < trace->width; i++) {
-        if (get_pixel(trace, i, j, k) > 0)
-          n[j]++;
+      if (j == trace->height - 1)
+        n_next = n_first;
+      else if (j == trace->height - 2)
+        n_next = n_last;
+      else {
+        row = &trace->array[k * trace->area + (j + 1) * trace->width];
+        n_next = 0;
+        for (i = 0; i < trace->width; i++)
+          n_next += (row[i] > 0);
       }
-      /*n[j]=MIN(n[j],trace->width); */
-      /*      n[j]=MAX(n[j],0); */
-    }
-    for (j = 0; j < trace->height; j++) {
-      m = (n[(j - 1) % trace->height] + 2 * n[j] + n[(j + 1) % trace->height])
-          / 4;
-      m = MAX(m,n[j]);
+      m = (n_prev + 2 * n_cur + n_next) / 4;
+      m = MAX(m,n_cur);
+      row = &trace->array[k * trace->area + j * trace->width];
       for (i = 0; i < trace->width; i++) {
         /* put_pixel(trace,i,j,k,255); */
-        c = get_pixel(trace, i, j, k) * m / trace->width;
-        c = MIN(c,255);
-        put_pixel(trace, i, j, k, c);
+        c = row[i] * m / trace->width;
+        row[i] = MIN(c,255);
       }
+      n_prev = n_cur;
+      n_cur = n_next;
     }
   }
-  RAVE_FREE(n);
 }
 
 void enhance_horz255(FmiImage *trace,Byte row_statistic[]){
   register int i,j;
   register int c,s;
-  
+  Byte *row;
+
   for (j=0;j<trace->height;j++){
     s=row_statistic[j];
+    row=&trace->array[j*trace->width];
     for (i=0;i<trace->width;i++){
-      c=get_pixel(trace,i,j,0)*s/255;
-      put_pixel(trace,i,j,0,c);
+      c=row[i]*s/255;
+      row[i]=c;
     }
   }
 } 
@@ -376,24 +393,70 @@ void detect_horz_segments(FmiImage *source,FmiImage *trace,int max_width,int min
 
 /* UNITY-WIDTH SEGMENTS */
 /* CLIENTS: detect_emitters2 */
+/* Fused form of: detect_vert_maxima, threshold_image(min_elevation), */
+/* horz_seg_lengths, threshold_image(min_length-1), semisigmoid_image. */
+/* Each row needs only its neighbours in source; the stages after the */
+/* maxima are row-local and run on a single row buffer. */
 void detect_emitters(FmiImage *source,FmiImage *trace,int min_elevation,int min_length){
+	int i,j,k,start;
+	int in_place;
+	Byte g,gmax,length;
+	Byte elevation_threshold,length_threshold;
+	Byte sigmoid[256];
+	Byte *src,*up,*down,*dst;
+	Byte *row,*prev;
 
 	canonize_image(source,trace);
-
-	/* FIND VERT MAXIMA... */
-	/* DEBUG threshold_image(source,trace,min_elevation); */
-	/*detect_vert_maxima(source,trace); */
-
-
-	detect_vert_maxima(source,trace);
-	/*put_pixel(trace,20,20,0,200); */
-	threshold_image(trace,trace,min_elevation);
-	if (FMI_DEBUG(5)) write_image("debug_emitter_1_vert_max",trace,PGM_RAW);
-
-	/* ... AND COMPUTE HORZ LENGTHS */
-	horz_seg_lengths(trace,trace);
-	threshold_image(trace,trace,min_length-1);
-	semisigmoid_image(trace,min_length);
+	in_place=(source->array==trace->array);
+	elevation_threshold=(Byte)min_elevation;
+	length_threshold=(Byte)(min_length-1);
+	for (i=0;i<256;i++)
+		sigmoid[i]=pseudo_sigmoid(min_length,i);
+
+	row=(Byte *)RAVE_MALLOC(2*MAX(source->width,1)*sizeof(Byte));
+	if (row==NULL)
+		fmi_error("detect_emitters: memory allocation failed");
+	/* in place, the row above has already been replaced by its maxima */
+	prev=&row[MAX(source->width,1)];
+
+	for (k=0;k<source->channels;k++){
+		for (j=0;j<source->height;j++){
+			src=&source->array[k*source->area+j*source->width];
+			dst=&trace->array[k*trace->area+j*trace->width];
+
+			/* FIND VERT MAXIMA... (outermost rows are not touched) */
+			if ((j==0)||(j==source->height-1))
+				memcpy(row,dst,source->width);
+			else {
+				up=in_place ? prev : src-source->width;
+				down=src+source->width;
+				for (i=0;i<source->width;i++){
+					g=src[i];
+					gmax=MAX(up[i],down[i]);
+					row[i]=(g>gmax) ? (Byte)(g-gmax) : 0;
+				}
+			}
+			if (in_place)
+				memcpy(prev,row,source->width);
+
+			/* ... AND COMPUTE HORZ LENGTHS */
+			i=0;
+			while (i<source->width){
+				if (row[i]<=elevation_threshold){
+					dst[i++]=sigmoid[0];
+					continue;
+				}
+				start=i;
+				while ((i<source->width)&&(row[i]>elevation_threshold))
+					i++;
+				length=horz_seg_length(i-start);
+				if (length<=length_threshold)
+					length=0;
+				memset(&dst[start],sigmoid[length],i-start);
+			}
+		}
+	}
+	RAVE_FREE(row);
 
 	if (FMI_DEBUG(4)) write_image("debug_emitter",trace,PGM_RAW);
 
@@ -436,7 +499,7 @@ void detect_emitters2(FmiImage *source,FmiImage *trace,int min_intensity,int min
   detect_emitters(source,&temp,min_intensity/2,min_length/2);
   /* ...TO BE USED AS TENTATIVE EVIDENCE. */
   image_average_horz(&temp,&mask);
-  pipeline_process(&mask ,&mask2,0,1,histogram_max);
+  morph_dilation(&mask,&mask2,MORPH_VERT_LINE,0,1,0);
   pipeline_process(&mask2,&mask ,0,1,histogram_mean);
   /*semisigmoid_image(&mask,32); */
   sigmoid_image(&mask,16,2);
@@ -585,6 +648,18 @@ void detect_emitters2old(FmiImage *source,FmiImage *trace,int min_intensity,int
 
 
 
+/* Horizontal closing of gates above min_intensity, marked with 255. */
+/* Sun detection uses only the support of the closed image, which is the */
+/* same as that of the grey-level closing of threshold_image(). */
+static void close_horz_support(FmiImage *source,FmiImage *trace,int min_intensity,int closing_dist){
+  FmiBitImage bits;
+  init_new_bit_image(&bits);
+  image_to_bits(source,&bits,min_intensity);
+  bits_closing(&bits,&bits,closing_dist,0,0);
+  bits_to_image(&bits,trace,255);
+  reset_bit_image(&bits);
+}
+
 void detect_sun(FmiImage *source,FmiImage *trace,int min_intensity,int max_width,int min_total_length){
   /*  FmiImage mask; */
   const int closing_dist=4;
@@ -594,8 +669,7 @@ void detect_sun(FmiImage *source,FmiImage *trace,int min_intensity,int max_width
   /*  initialize_vert_stripe(&mask,source->height); */
 
   /*   */
-  threshold_image(source,trace,min_intensity);
-  morph_closing(trace,trace,closing_dist,0); 
+  close_horz_support(source,trace,min_intensity,closing_dist);
   detect_horz_segments(trace,trace,max_width,min_seg_length);
 
   horz_seg_lengths(trace,trace);
@@ -631,8 +705,7 @@ void detect_sun2(FmiImage *source,FmiImage *trace,int min_intensity,int max_widt
   }
 
   /*  detect_sun(source,trace,min_intensity,min_length,max_width);  */
-  threshold_image(source,trace,min_intensity);
-  morph_closing(trace,trace,closing_dist,0); 
+  close_horz_support(source,trace,min_intensity,closing_dist);
   if (FMI_DEBUG(5)) write_image("debug_sun1",trace,PGM_RAW);
   detect_horz_segments(trace,trace,max_width,min_total_length);
   if (FMI_DEBUG(5)) write_image("debug_sun2",trace,PGM_RAW);
@@ -654,131 +727,124 @@ void detect_sun2(FmiImage *source,FmiImage *trace,int min_intensity,int max_widt
  /* fmi_debug(2,"sun2"); */
 }
 
+/* Operators of the ship detector graph, none of them uses node parameters */
+static void ship_cut_segments(FmiImage **input,FmiImage *target,FmiGraphNode *node){
+  (void)node;
+  propagate_right(input[0],input[0],target,-16,put_pixel);
+  propagate_left(target,target,target,0,put_pixel_min);
+}
+
+static void ship_virtual_echoes(FmiImage **input,FmiImage *target,FmiGraphNode *node){
+  (void)node;
+  iir_updown(input[0],target,975);
+}
+
+static void ship_vert_edges(FmiImage **input,FmiImage *target,FmiGraphNode *node){
+  (void)node;
+  detect_vert_edges(input[0],target);
+}
+
+static void ship_long_edges(FmiImage **input,FmiImage *target,FmiGraphNode *node){
+  (void)node;
+  propagate_up(NULL,input[0],target,1*8,put_pixel);
+  propagate_down(target,target,target,0,put_pixel);
+}
+
+static void ship_horz_closing(FmiImage **input,FmiImage *target,FmiGraphNode *node){
+  (void)node;
+  morph_closing_element(input[0],target,MORPH_HORZ_LINE,1,0,0);
+}
+
+static void ship_horz_lengths(FmiImage **input,FmiImage *target,FmiGraphNode *node){
+  (void)node;
+  horz_seg_lengths(input[0],target);
+}
+
+static void ship_vert_dilation(FmiImage **input,FmiImage *target,FmiGraphNode *node){
+  (void)node;
+  morph_dilation(input[0],target,MORPH_VERT_LINE,0,1,0);
+}
+
 /* 
    BASIC IDEA
    - Detect specks, of which size < "max_area" and intensity > "min_intensity"
    - SPECK must be pronounced, not just thresholded
 */
 void detect_ships(FmiImage *source,FmiImage *prob,int min_intensity,int max_area){
-  /* register int i; */
   int max_radius;
-  /*  FmiImage trace;   */
-  /*  FmiImage trace; */
-  /*FmiImage trace4; */
-
-  FmiImage temp1;
-  FmiImage temp2;
-  /*  FmiImage temp3; */
-  FmiImage specks;
-  FmiImage virtual;
-  FmiImage lines;
+  FmiImageGraph graph;
+  int mean,specks,virtual,edges,lines,segments,sidelobes,combined,smooth,result;
 
   max_radius=sqrt(max_area)/2;
 
-  init_new_image(&temp1);
-  init_new_image(&temp2);
-  init_new_image(&specks);
-  init_new_image(&virtual);
-  init_new_image(&lines);
-
-  canonize_image(source,&temp1);
-  fmi_debug(2,"--------------");
-  if (FMI_DEBUG(2)) image_info(&temp1);
-  fmi_debug(2,"==============");
-
-  canonize_image(source,&temp2);
-  /*  image_info(&temp2); */
-  /* canonize_image(source,&temp3); */
-  canonize_image(source,&specks);
-  canonize_image(source,&virtual);
-  canonize_image(source,&lines);
-
-  /*  fmi_debug(2,"--------------"); */
-  /*
-    image_info(&temp1);
-    image_info(&temp2);
-    image_info(&specks);
-    image_info(&virtual);
-    image_info(&lines);
-  */
   fmi_debug(2,"remove ships2");
+  init_image_graph(&graph,source);
 
   /* high-boost filter for detecting specks */
-  pipeline_process(source,&temp1,max_radius+2,max_radius+2,histogram_mean);
-  subtract_image(source,&temp1,&specks); 
-  threshold_image(&specks,&specks,min_intensity);
-  if (FMI_DEBUG(5)) write_image("debug_ship_speck1",&specks,PGM_RAW);
+  mean=graph_pipeline(&graph,NULL,FMI_GRAPH_SOURCE,max_radius+2,max_radius+2,histogram_mean);
+  specks=graph_binary(&graph,NULL,GRAPH_SUBTRACT,FMI_GRAPH_SOURCE,mean);
+  specks=graph_threshold(&graph,"debug_ship_speck1",specks,min_intensity);
 
   /* cut off short segments */
-  propagate_right(&specks,&specks,&specks,-16,put_pixel);
-  propagate_left(&specks,&specks,&specks,0,put_pixel_min);
-  threshold_image(&specks,&specks,min_intensity/2);
-  if (FMI_DEBUG(4)) write_image("debug_ship_speck2",&specks,PGM_RAW);
+  specks=graph_op(&graph,NULL,ship_cut_segments,specks,FMI_GRAPH_NONE);
+  specks=graph_threshold(&graph,"debug_ship_speck2",specks,min_intensity/2);
 
   /* create virtual echoes (= locations of possible sidelobe echoes) */
-  iir_up(&specks,&temp1,975);
-  iir_down(&specks,&temp2,975);
-  max_image(&temp1,&temp2,&virtual);
-  if (FMI_DEBUG(4)) write_image("debug_ship_virtual",&virtual,PGM_RAW);
-
+  virtual=graph_op(&graph,"debug_ship_virtual",ship_virtual_echoes,specks,FMI_GRAPH_NONE);
 
   /* detect possible sidelobe echoes in data */
   /*  edges */
-  detect_vert_edges(source,&temp1);
-  threshold_image(&temp1,&temp1,8);
+  edges=graph_op(&graph,NULL,ship_vert_edges,FMI_GRAPH_SOURCE,FMI_GRAPH_NONE);
+  edges=graph_threshold(&graph,NULL,edges,8);
   /*  emphasize long segments, prune short segments */
-  propagate_up(NULL,&temp1,&temp2,1*8,put_pixel);
-  propagate_down(&temp2,&temp2,&lines,0,put_pixel);
-  threshold_image(&lines,&lines,2*8);
-  if (FMI_DEBUG(3)) write_image("debug_ship_edges",&lines,PGM_RAW);
+  lines=graph_op(&graph,NULL,ship_long_edges,edges,FMI_GRAPH_NONE);
+  lines=graph_threshold(&graph,"debug_ship_edges",lines,2*8);
 
   /*  detect suspicious segments = connect HORZ segments */
-  pipeline_process(source,&temp2,1,0,histogram_max);
-  pipeline_process(&temp2,&temp1,1,0,histogram_min);
-  if (FMI_DEBUG(4)) write_image("debug_ship_edges2",&temp1,PGM_RAW);
-  propagate_right(NULL,&temp1,&temp2,1,put_pixel);
-  propagate_left(&temp2,&temp2,&temp1,0,put_pixel);
-  if (FMI_DEBUG(4)) write_image("debug_ship_edges3",&temp1,PGM_RAW);
+  segments=graph_op(&graph,"debug_ship_edges2",ship_horz_closing,FMI_GRAPH_SOURCE,FMI_GRAPH_NONE);
+  segments=graph_op(&graph,"debug_ship_edges3",ship_horz_lengths,segments,FMI_GRAPH_NONE);
 
   /* here we get the "real" sidelobes */
-  subtract_image(&lines,&temp1,&lines);
-  pipeline_process(&lines,&temp1,0,1,histogram_max);
-  pipeline_process(&temp1,&lines,0,2,histogram_mean);
-  if (FMI_DEBUG(4)) write_image("debug_ship_edges4",&lines,PGM_RAW);
-
-  /*  multiply_image(&lines,&virtual,&lines); */
-  min_image(&lines,&virtual,&lines);
-  if (FMI_DEBUG(3)) write_image("debug_ship_edges5",&lines,PGM_RAW);
+  sidelobes=graph_binary(&graph,NULL,GRAPH_SUBTRACT,lines,segments);
+  sidelobes=graph_op(&graph,NULL,ship_vert_dilation,sidelobes,FMI_GRAPH_NONE);
+  sidelobes=graph_pipeline(&graph,"debug_ship_edges4",sidelobes,0,2,histogram_mean);
+  sidelobes=graph_binary(&graph,"debug_ship_edges5",GRAPH_MIN,sidelobes,virtual);
 
   /* combine ships and their sidelobes */
-  max_image(&specks,&lines,prob);
+  combined=graph_binary(&graph,NULL,GRAPH_MAX,specks,sidelobes);
+  smooth=graph_pipeline(&graph,NULL,combined,1,2,histogram_mean); /* smooth a bit */
+  result=graph_binary(&graph,NULL,GRAPH_AVERAGE,combined,smooth);
+  result=graph_scale255(&graph,NULL,result,768);
 
-  pipeline_process(prob,&temp1,1,2,histogram_mean); /* smooth a bit */
-  average_images(prob,&temp1,prob);
-  multiply_image_scalar255(prob,768);
-  /*  if (FMI_DEBUG(3)) write_image("ships",prob,PGM_RAW); */
-  
-  /*  reset_image(&trace);  */
-  fmi_debug(2,"remove ships2: reset temp1");
-  fmi_debug(2,"--------------");
-  if (FMI_DEBUG(2)) image_info(&temp1);
-  fmi_debug(2,"==============");
-  reset_image(&temp1);
-  fmi_debug(2,"remove ships2: reset temp2");
-  reset_image(&temp2);
-  fmi_debug(2,"remove ships2: reset specks1");
-  reset_image(&specks);
-  reset_image(&virtual);
-  reset_image(&lines);
+  graph_execute(&graph,result,prob);
 }
 
 
 void detect_doppler_anomaly(FmiImage *source,FmiImage *target,int width, int height,int threshold){
   /* peura hack 10.12.2002:�gaussian  - ADDS PASSIVE ARE NEAR ZERO */
   /*  histogram_threshold=threshold; */
+  FmiImageGraph graph;
+  FmiImage ramp;
+  int i,variance;
+
   histogram_threshold=128;
-  pipeline_process(source,target,width,height,histogram_variance_rot);
-  sigmoid_image(target,threshold,threshold/16);
+
+  /* sigmoid_image() as a lookup table */
+  init_new_image(&ramp);
+  ramp.width=256;
+  ramp.height=1;
+  ramp.channels=1;
+  initialize_byte_image(&ramp);
+  for (i=0;i<256;i++)
+    ramp.array[i]=i;
+  sigmoid_image(&ramp,threshold,threshold/16);
+
+  /* local chain: evaluated in cache-sized strips of rays */
+  init_image_graph(&graph,source);
+  variance=graph_pipeline(&graph,NULL,FMI_GRAPH_SOURCE,width,height,histogram_variance_rot);
+  variance=graph_lut(&graph,NULL,variance,ramp.array);
+  graph_execute_tiled(&graph,variance,target,0);
+  reset_image(&ramp);
   /*invert_image(target); */
   if (FMI_DEBUG(4)) write_image("debug_doppler",target,PGM_RAW);
   /*pipeline_process(source,target,1,1,histogram_mean); */
@@ -41,6 +41,7 @@ struct _RaveFmiImage_t {
   double gain; /**< the offset the data has been stored with */
   double nodata; /**< the nodata the data has been stored with */
   double undetect; /**< the undetect the data has been stored with */
+  FmiRadarPGMCode pgmCode; /**< the pgm code of the detector that produced the image */
 };
 
 /*@{ Private functions */
@@ -76,6 +77,7 @@ static int RaveFmiImage_constructor(RaveCoreObject* obj)
   this->gain = 1.0;
   this->nodata = 255.0;
   this->undetect = 0.0;
+  this->pgmCode = CLEAR;
   this->image = new_image(1);
   this->attrs = RAVE_OBJECT_NEW(&RaveObjectHashTable_TYPE);
   if (this->image == NULL || this->attrs == NULL) {
@@ -113,6 +115,7 @@ static int RaveFmiImage_copyconstructor(RaveCoreObject* obj, RaveCoreObject* src
   this->gain = src->gain;
   this->nodata = src->nodata;
   this->undetect = src->undetect;
+  this->pgmCode = src->pgmCode;
   this->image = new_image(1);
   this->attrs = RAVE_OBJECT_CLONE(src->attrs);
   if (this->image == NULL || this->attrs == NULL) {
@@ -322,6 +325,7 @@ static PolarScan_t* RaveFmiImageInternal_fmiImageToScan(RaveFmiImage_t* self, co
   PolarScanParam_t* param = NULL;
   int ray = 0, bin = 0;
   FmiImage* image = NULL;
+  int bytesOnly = 0;
 
   RAVE_ASSERT((self != NULL), "self == NULL");
 
@@ -334,7 +338,10 @@ static PolarScan_t* RaveFmiImageInternal_fmiImageToScan(RaveFmiImage_t* self, co
     goto done;
   }
 
-  if (datatype != 2 && (image->original_type == RaveDataType_CHAR || image->original_type == RaveDataType_UCHAR || datatype == 1)) {
+  bytesOnly = (image->original == NULL ||
+               (datatype != 2 && (image->original_type == RaveDataType_CHAR || image->original_type == RaveDataType_UCHAR || datatype == 1)));
+
+  if (bytesOnly) {
     PolarScanParam_setGain(param, self->gain);
     PolarScanParam_setOffset(param, self->offset);
     PolarScanParam_setNodata(param, self->nodata);
@@ -373,7 +380,7 @@ static PolarScan_t* RaveFmiImageInternal_fmiImageToScan(RaveFmiImage_t* self, co
 
   for (ray = 0; ray < image->height; ray++) {
     for (bin = 0; bin < image->width; bin++) {
-      if (datatype != 2 && (image->original_type == RaveDataType_CHAR || image->original_type == RaveDataType_UCHAR || datatype == 1)) {
+      if (bytesOnly) {
         PolarScanParam_setValue(param, bin, ray, (double)get_pixel(image, bin, ray, 0));
       } else {
         double v = (double)get_pixel_orig(image, bin, ray, 0);
@@ -417,6 +424,7 @@ static RaveField_t* RaveFmiImageInternal_fmiImageToField(FmiImage* image, int da
   RaveField_t* field = NULL;
   RaveField_t* result = NULL;
   int ray = 0, bin = 0;
+  int bytesOnly = 0;
   RAVE_ASSERT((image != NULL), "image == NULL");
 
   field = RAVE_OBJECT_NEW(&RaveField_TYPE);
@@ -437,9 +445,12 @@ static RaveField_t* RaveFmiImageInternal_fmiImageToField(FmiImage* image, int da
     }
   }
 
+  bytesOnly = (image->original == NULL ||
+               (datatype != 2 && (image->original_type == RaveDataType_CHAR || image->original_type == RaveDataType_UCHAR || datatype == 1)));
+
   for (ray = 0; ray < image->height; ray++) {
     for (bin = 0; bin < image->width; bin++) {
-      if (datatype != 2 && (image->original_type == RaveDataType_CHAR || image->original_type == RaveDataType_UCHAR || datatype == 1)) {
+      if (bytesOnly) {
         RaveField_setValue(field, bin, ray, (double)get_pixel(image, bin, ray, 0));
       } else {
         RaveField_setValue(field, bin, ray, (double)get_pixel_orig(image, bin, ray, 0));
@@ -724,6 +735,18 @@ double RaveFmiImage_getOriginalUndetect(RaveFmiImage_t* self)
   return self->image->original_undetect;
 }
 
+void RaveFmiImage_setPgmCode(RaveFmiImage_t* self, FmiRadarPGMCode code)
+{
+  RAVE_ASSERT((self != NULL), "self == NULL");
+  self->pgmCode = code;
+}
+
+FmiRadarPGMCode RaveFmiImage_getPgmCode(RaveFmiImage_t* self)
+{
+  RAVE_ASSERT((self != NULL), "self == NULL");
+  return self->pgmCode;
+}
+
 RaveFmiImage_t* RaveFmiImage_new(int width, int height)
 {
   RaveFmiImage_t* result = RAVE_OBJECT_NEW(&RaveFmiImage_TYPE);
@@ -735,6 +758,35 @@ RaveFmiImage_t* RaveFmiImage_new(int width, int height)
   return result;
 }
 
+RaveFmiImage_t* RaveFmiImage_newByteImage(RaveFmiImage_t* sample)
+{
+  RaveFmiImage_t* result = NULL;
+
+  RAVE_ASSERT((sample != NULL), "sample == NULL");
+
+  if (sample->image == NULL || sample->image->width <= 0 || sample->image->height <= 0) {
+    RAVE_ERROR0("You can not create a byte image from an empty image");
+    return NULL;
+  }
+
+  result = RAVE_OBJECT_NEW(&RaveFmiImage_TYPE);
+  if (result != NULL) {
+    copy_image_properties(sample->image, result->image);
+    result->image->channels = 1;
+    result->image->original_type = RaveDataType_UCHAR;
+    if (!initialize_byte_image(result->image)) {
+      RAVE_CRITICAL0("Failed to allocate memory for byte image");
+      RAVE_OBJECT_RELEASE(result);
+      return NULL;
+    }
+    result->offset = sample->offset;
+    result->gain = sample->gain;
+    result->nodata = sample->nodata;
+    result->undetect = sample->undetect;
+  }
+  return result;
+}
+
 RaveFmiImage_t* RaveFmiImage_fromPolarVolume(PolarVolume_t* volume, int scannr, const char* quantity)
 {
   int nrScans = 0;
@@ -27,6 +27,7 @@ along with bRopo.  If not, see <http://www.gnu.org/licenses/>.
 #ifndef RAVE_FMI_IMAGE_H
 #define RAVE_FMI_IMAGE_H
 #include "fmi_image.h"
+#include "fmi_radar_image.h"
 #include "rave_object.h"
 #include "polarvolume.h"
 #include "polarscan.h"
@@ -233,6 +234,20 @@ void RaveFmiImage_setOriginalUndetect(RaveFmiImage_t* self, double v);
  */
 double RaveFmiImage_getOriginalUndetect(RaveFmiImage_t* self);
 
+/**
+ * Sets the pgm code of the detector that produced this image when it is a probability field.
+ * @param[in] self - self
+ * @param[in] code - the pgm code
+ */
+void RaveFmiImage_setPgmCode(RaveFmiImage_t* self, FmiRadarPGMCode code);
+
+/**
+ * Returns the pgm code of the detector that produced this image.
+ * @param[in] self - self
+ * @return the pgm code, default is CLEAR
+ */
+FmiRadarPGMCode RaveFmiImage_getPgmCode(RaveFmiImage_t* self);
+
 /**
  * Creates a rave fmi image with specified dimension
  * @param[in] width - the width
@@ -241,6 +256,15 @@ double RaveFmiImage_getOriginalUndetect(RaveFmiImage_t* self);
  */
 RaveFmiImage_t* RaveFmiImage_new(int width, int height);
 
+/**
+ * Creates a rave fmi image with the same geometry as sample but with byte data only,
+ * i.e. no original data is allocated. The pixels are not initialized and the image
+ * has no attributes. Suitable for probability fields.
+ * @param[in] sample - the image providing the geometry
+ * @return the fmi image on success otherwise NULL
+ */
+RaveFmiImage_t* RaveFmiImage_newByteImage(RaveFmiImage_t* sample);
+
 /**
  * Creates a fmi image from a specific scan in a polar volume
  * @param[in] volume - the polar volume
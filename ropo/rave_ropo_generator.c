@@ -24,9 +24,11 @@ along with bRopo.  If not, see <http://www.gnu.org/licenses/>.
  * @author Anders Henja (Swedish Meteorological and Hydrological Institute, SMHI)
  * @date 2011-09-02
  */
+#include <ctype.h>
 #include <limits.h>
 #include <math.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include <stdarg.h>
 #include <fmi_util.h>
@@ -54,60 +56,21 @@ struct _RaveRopoGenerator_t {
   RaveObjectList_t* probabilities; /**< a list of probabilities */
   RaveFmiImage_t* classification; /**< the classification field */
   RaveFmiImage_t* markers; /**< the markers identifying what type of detector indicating probability */
-};
-
-/*@{ Private functions */
-static const char RopoGenerator_CLEAR_STR[] = "CLEAR:";
-static const char RopoGenerator_CUTOFF_STR[] = "CUTOFF:";
-static const char RopoGenerator_BIOMET_STR[] = "BIOMET:";
-static const char RopoGenerator_SHIP_STR[] = "SHIP:";
-static const char RopoGenerator_SUN_STR[] = "SUN:";
-static const char RopoGenerator_EMITTER_STR[] = "EMITTER:";
-static const char RopoGenerator_EMITTER2_STR[] = "EMITTER2:";
-static const char RopoGenerator_CLUTTER_STR[] = "CLUTTER:";
-static const char RopoGenerator_CLUTTER2_STR[] = "CLUTTER2:";
-static const char RopoGenerator_SPECK_STR[] = "SPECK:";
-static const char RopoGenerator_SPECKNORMOLD_STR[] = "SPECKNORMOLD:";
-static const char RopoGenerator_DOPPLER_STR[] = "DOPPLER:";
-//static const char RopoGenerator_GROUND_STR[] = "GROUND:";
-static const char RopoGenerator_METEOSAT_STR[] = "METEOSAT:";
-static const char RopoGenerator_THRESH1_STR[] = "THRESH1:";
-static const char RopoGenerator_EMITTER3_STR[] = "EMITTER3:";
-static const char RopoGenerator_DATA_MIN_STR[] = "DATA_MIN:";
-static const char RopoGenerator_DATA_MAX_STR[] = "DATA_MAX:";
-static const char RopoGenerator_NO_DATA_STR[] = "NO_DATA:";
-
-struct RopoGenerator_PgmCodeMapping {
-  FmiRadarPGMCode type;  /**< the pgm code */
-  const char* str;       /**< the string representation */
+  int azimuthWrap; /**< if first and last ray should be treated as neighbours */
+  int keepProbabilities; /**< if the probability fields are kept after being merged into the classification */
+  RaveFmiImage_t* spareProbability; /**< a discarded probability field that can be reused by the next detector */
 };
 
 /**
- * The product type mapping table.
+ * How flagged gates are replaced when restoring.
  */
-static const struct RopoGenerator_PgmCodeMapping PGM_CODE_MAPPING[] =
-{
-  {CLEAR,  RopoGenerator_CLEAR_STR},
-  {CUTOFF,  RopoGenerator_CUTOFF_STR},
-  {BIOMET,  RopoGenerator_BIOMET_STR},
-  {SHIP,  RopoGenerator_SHIP_STR},
-  {SUN,  RopoGenerator_SUN_STR},
-  {EMITTER,  RopoGenerator_EMITTER_STR},
-  {EMITTER2,  RopoGenerator_EMITTER2_STR},
-  {CLUTTER,  RopoGenerator_CLUTTER_STR},
-  {CLUTTER2,  RopoGenerator_CLUTTER2_STR},
-  {SPECK,  RopoGenerator_SPECK_STR},
-  {SPECK, RopoGenerator_SPECKNORMOLD_STR},
-  {DOPPLER,  RopoGenerator_DOPPLER_STR},
-  {METEOSAT,  RopoGenerator_METEOSAT_STR},
-  {THRESH1,  RopoGenerator_THRESH1_STR},
-  {EMITTER3,  RopoGenerator_EMITTER3_STR},
-  {DATA_MIN,  RopoGenerator_DATA_MIN_STR},
-  {DATA_MAX,  RopoGenerator_DATA_MAX_STR},
-  {NO_DATA,  RopoGenerator_NO_DATA_STR},
-  {-1, NULL}
-};
+typedef enum RaveRopoRestoreMethod {
+  RaveRopoRestoreMethod_ERASE = 0, /**< set to undetect, see \ref RaveRopoGenerator_restore */
+  RaveRopoRestoreMethod_FILL,      /**< neighbourhood mean, see \ref RaveRopoGenerator_restore2 */
+  RaveRopoRestoreMethod_PYRAMID    /**< pyramid interpolation, see \ref RaveRopoGenerator_restorePyramid */
+} RaveRopoRestoreMethod;
 
+/*@{ Private functions */
 /**
  * Constructor
  */
@@ -117,6 +80,9 @@ static int RaveRopoGenerator_constructor(RaveCoreObject* obj)
   this->image = NULL;
   this->classification = NULL;
   this->markers = NULL;
+  this->azimuthWrap = 0;
+  this->keepProbabilities = 1;
+  this->spareProbability = NULL;
   this->probabilities = RAVE_OBJECT_NEW(&RaveObjectList_TYPE);
 
   if (this->probabilities == NULL) {
@@ -138,6 +104,7 @@ static void RaveRopoGenerator_destructor(RaveCoreObject* obj)
   RAVE_OBJECT_RELEASE(src->probabilities);
   RAVE_OBJECT_RELEASE(src->classification);
   RAVE_OBJECT_RELEASE(src->markers);
+  RAVE_OBJECT_RELEASE(src->spareProbability);
 }
 
 /**
@@ -271,41 +238,6 @@ done:
   return result;
 }
 
-/**
- * Gets the attribute how/task_args and atempts to determine a FmiRadarPGMCode from
- * the string.
- * @param[in] image - the image
- * @return the identified PGM code on success or CLEAR if nothing could be identified
- */
-static FmiRadarPGMCode RaveRopoGeneratorInternal_getPgmCode(RaveFmiImage_t* image)
-{
-  RaveAttribute_t* taskargs = NULL;
-  FmiRadarPGMCode result = CLEAR;
-  RAVE_ASSERT((image != NULL), "image == NULL");
-
-  taskargs = RaveFmiImage_getAttribute(image, "how/task_args");
-  if (taskargs != NULL) {
-    char* argument = NULL;
-    int index = 0;
-    if (!RaveAttribute_getString(taskargs, &argument)) {
-      goto done;
-    }
-    if (argument == NULL) {
-      goto done;
-    }
-    while (PGM_CODE_MAPPING[index].str != NULL) {
-      if (strncmp(PGM_CODE_MAPPING[index].str, argument, strlen(PGM_CODE_MAPPING[index].str))==0) {
-        result = PGM_CODE_MAPPING[index].type;
-        goto done;
-      }
-      index++;
-    }
-  }
-done:
-  RAVE_OBJECT_RELEASE(taskargs);
-  return result;
-}
-
 /**
  * Creates a valid 8 bit value in range 0-255 from the wanted value translated
  * with the offset and gain.
@@ -370,20 +302,132 @@ static int RaveRopoGeneratorInternal_relValueToByteRange(int value, RaveFmiImage
 
 
 /**
- * Clears the classification information. Should be run at the end of all
- * detectors so that proper classficiation information can be returned.
- * @param[in] self - self
+ * The maximum number of arguments a registered detector takes.
  */
-static void RaveRopoGeneratorInternal_removeClassifications(RaveRopoGenerator_t* self)
+#define RopoGenerator_MAX_DETECTOR_ARGS 5
+
+/**
+ * Runs a registered detector with the arguments of a pipeline step.
+ */
+typedef int (*RopoGenerator_DetectorFunction)(RaveRopoGenerator_t* self, const int* args);
+
+/**
+ * A detector that can be used in a pipeline, see \ref RaveRopoGenerator_run.
+ */
+struct RopoGenerator_Detector {
+  const char* name;        /**< the name used in the pipeline */
+  const char* parameters;  /**< the parameter names, comma separated */
+  int nargs;               /**< the number of integer arguments */
+  FmiRadarPGMCode code;    /**< the pgm code of the probability field */
+  RopoGenerator_DetectorFunction run; /**< the function running the detector */
+};
+
+/**
+ * One step of a parsed pipeline.
+ */
+struct RopoGenerator_PipelineStep {
+  const struct RopoGenerator_Detector* detector; /**< the detector */
+  int args[RopoGenerator_MAX_DETECTOR_ARGS];    /**< the arguments */
+};
+
+static int RaveRopoGeneratorInternal_runSpeck(RaveRopoGenerator_t* self, const int* args)
 {
-  RAVE_OBJECT_RELEASE(self->classification);
-  RAVE_OBJECT_RELEASE(self->markers);
+  return RaveRopoGenerator_speck(self, args[0], args[1]);
+}
+
+static int RaveRopoGeneratorInternal_runSpeckNormOld(RaveRopoGenerator_t* self, const int* args)
+{
+  return RaveRopoGenerator_speckNormOld(self, args[0], args[1], args[2]);
+}
+
+static int RaveRopoGeneratorInternal_runEmitter(RaveRopoGenerator_t* self, const int* args)
+{
+  return RaveRopoGenerator_emitter(self, args[0], args[1]);
+}
+
+static int RaveRopoGeneratorInternal_runEmitter2(RaveRopoGenerator_t* self, const int* args)
+{
+  return RaveRopoGenerator_emitter2(self, args[0], args[1], args[2]);
 }
 
+static int RaveRopoGeneratorInternal_runClutter(RaveRopoGenerator_t* self, const int* args)
+{
+  return RaveRopoGenerator_clutter(self, args[0], args[1]);
+}
+
+static int RaveRopoGeneratorInternal_runClutter2(RaveRopoGenerator_t* self, const int* args)
+{
+  return RaveRopoGenerator_clutter2(self, args[0], args[1]);
+}
+
+static int RaveRopoGeneratorInternal_runSoftcut(RaveRopoGenerator_t* self, const int* args)
+{
+  return RaveRopoGenerator_softcut(self, args[0], args[1], args[2]);
+}
+
+static int RaveRopoGeneratorInternal_runBiomet(RaveRopoGenerator_t* self, const int* args)
+{
+  return RaveRopoGenerator_biomet(self, args[0], args[1], args[2], args[3]);
+}
+
+static int RaveRopoGeneratorInternal_runShip(RaveRopoGenerator_t* self, const int* args)
+{
+  return RaveRopoGenerator_ship(self, args[0], args[1]);
+}
+
+static int RaveRopoGeneratorInternal_runSun(RaveRopoGenerator_t* self, const int* args)
+{
+  return RaveRopoGenerator_sun(self, args[0], args[1], args[2]);
+}
+
+static int RaveRopoGeneratorInternal_runSun2(RaveRopoGenerator_t* self, const int* args)
+{
+  return RaveRopoGenerator_sun2(self, args[0], args[1], args[2], args[3], args[4]);
+}
+
+/**
+ * The index of each detector in the registry.
+ */
+typedef enum RopoGenerator_DetectorId {
+  RopoGenerator_SPECK = 0,
+  RopoGenerator_SPECKNORMOLD,
+  RopoGenerator_EMITTER,
+  RopoGenerator_EMITTER2,
+  RopoGenerator_CLUTTER,
+  RopoGenerator_CLUTTER2,
+  RopoGenerator_SOFTCUT,
+  RopoGenerator_BIOMET,
+  RopoGenerator_SHIP,
+  RopoGenerator_SUN,
+  RopoGenerator_SUN2,
+  RopoGenerator_DETECTOR_COUNT
+} RopoGenerator_DetectorId;
+
+/**
+ * The detector registry. The detectors mark their probability fields with
+ * the code of their entry.
+ */
+static const struct RopoGenerator_Detector DETECTOR_REGISTRY[RopoGenerator_DETECTOR_COUNT + 1] =
+{
+  [RopoGenerator_SPECK] = {"speck", "minDbz,maxA", 2, SPECK, RaveRopoGeneratorInternal_runSpeck},
+  [RopoGenerator_SPECKNORMOLD] = {"speckNormOld", "minDbz,maxA,maxN", 3, SPECK, RaveRopoGeneratorInternal_runSpeckNormOld},
+  [RopoGenerator_EMITTER] = {"emitter", "minDbz,length", 2, EMITTER, RaveRopoGeneratorInternal_runEmitter},
+  [RopoGenerator_EMITTER2] = {"emitter2", "minDbz,length,width", 3, EMITTER2, RaveRopoGeneratorInternal_runEmitter2},
+  [RopoGenerator_CLUTTER] = {"clutter", "minDbz,maxCompactness", 2, CLUTTER, RaveRopoGeneratorInternal_runClutter},
+  [RopoGenerator_CLUTTER2] = {"clutter2", "minDbz,maxSmoothness", 2, CLUTTER2, RaveRopoGeneratorInternal_runClutter2},
+  [RopoGenerator_SOFTCUT] = {"softcut", "maxDbz,r,r2", 3, CLEAR, RaveRopoGeneratorInternal_runSoftcut},
+  [RopoGenerator_BIOMET] = {"biomet", "maxDbz,dbzDelta,maxAlt,altDelta", 4, BIOMET, RaveRopoGeneratorInternal_runBiomet},
+  [RopoGenerator_SHIP] = {"ship", "minRelDbz,minA", 2, SHIP, RaveRopoGeneratorInternal_runShip},
+  [RopoGenerator_SUN] = {"sun", "minDbz,minLength,maxThickness", 3, SUN, RaveRopoGeneratorInternal_runSun},
+  [RopoGenerator_SUN2] = {"sun2", "minDbz,minLength,maxThickness,azimuth,elevation", 5, CLEAR, RaveRopoGeneratorInternal_runSun2},
+  [RopoGenerator_DETECTOR_COUNT] = {NULL, NULL, 0, CLEAR, NULL}
+};
+
 /**
  * Creates a probability field with the task & task_args filled.
  * @param[in] self - self
  * @param[in,out] probability - the created probability field
+ * @param[in] detector - the registry index of the detector, gives the pgm code
  * @param[in] task - the detector how/task
  * @param[in] fmt - the detector how/task_args format string
  * @param[in] ... - the varargs list for the fmt string
@@ -392,6 +436,7 @@ static void RaveRopoGeneratorInternal_removeClassifications(RaveRopoGenerator_t*
 static int RaveRopoGeneratorInternal_createProbabilityField(
   RaveRopoGenerator_t* self,
   RaveFmiImage_t** probability,
+  RopoGenerator_DetectorId detector,
   const char* task,
   const char* fmt, ...)
 {
@@ -418,13 +463,20 @@ static int RaveRopoGeneratorInternal_createProbabilityField(
     goto done;
   }
 
-  outprob = RAVE_OBJECT_CLONE(self->image);
+  if (self->spareProbability != NULL &&
+      RaveFmiImage_getImage(self->spareProbability)->width == RaveFmiImage_getImage(self->image)->width &&
+      RaveFmiImage_getImage(self->spareProbability)->height == RaveFmiImage_getImage(self->image)->height) {
+    outprob = RAVE_OBJECT_COPY(self->spareProbability);
+  } else {
+    outprob = RaveFmiImage_newByteImage(self->image);
+  }
+  RAVE_OBJECT_RELEASE(self->spareProbability);
   if (outprob == NULL) {
-    RAVE_CRITICAL0("Failed to clone image");
+    RAVE_CRITICAL0("Failed to create probability field");
     goto done;
   }
   RaveFmiImage_fill(outprob, CLEAR);
-  RaveFmiImage_fillOriginal(outprob, (double)CLEAR);
+  RaveFmiImage_setPgmCode(outprob, DETECTOR_REGISTRY[detector].code);
 
   if (!RaveRopoGeneratorInternal_addTask(outprob, task) ||
       !RaveRopoGeneratorInternal_addTaskArgs(outprob, fmtstring)) {
@@ -441,6 +493,274 @@ done:
   return result;
 }
 
+/**
+ * Restores the generator image into target according to the classification.
+ * Target may be the generator image itself, otherwise it must have the same
+ * dimensions. Every gate of target is written, so it does not have to be cleared.
+ * @param[in] self - self
+ * @param[in] target - the image to write the restored data into
+ * @param[in] threshold - the probability threshold
+ * @param[in] method - how the anomalies are replaced
+ * @return 1 on success otherwise 0
+ */
+static int RaveRopoGeneratorInternal_restore(RaveRopoGenerator_t* self, RaveFmiImage_t* target, int threshold, RaveRopoRestoreMethod method)
+{
+  FmiImage* source = NULL;
+  FmiImage* image = NULL;
+  FmiImage* classification = NULL;
+  const char* task = NULL;
+  const char* fmt = NULL;
+  int result = 0;
+
+  if (self->classification == NULL || self->markers == NULL) {
+    RaveRopoGenerator_classify(self);
+  }
+
+  source = RaveFmiImage_getImage(self->image);
+  image = RaveFmiImage_getImage(target);
+  if (image == NULL || image->width != source->width || image->height != source->height ||
+      image->channels != source->channels) {
+    RAVE_ERROR0("Target dimensions differ from the image dimensions");
+    goto done;
+  }
+  if (source->original == NULL || image->original == NULL) {
+    RAVE_ERROR0("Restore needs original data in both image and target, probability fields have none");
+    goto done;
+  }
+
+  if (target != self->image) {
+    RaveFmiImage_setGain(target, RaveFmiImage_getGain(self->image));
+    RaveFmiImage_setOffset(target, RaveFmiImage_getOffset(self->image));
+    RaveFmiImage_setNodata(target, RaveFmiImage_getNodata(self->image));
+    RaveFmiImage_setUndetect(target, RaveFmiImage_getUndetect(self->image));
+    RaveFmiImage_setOriginalGain(target, RaveFmiImage_getOriginalGain(self->image));
+    RaveFmiImage_setOriginalOffset(target, RaveFmiImage_getOriginalOffset(self->image));
+    RaveFmiImage_setOriginalNodata(target, RaveFmiImage_getOriginalNodata(self->image));
+    RaveFmiImage_setOriginalUndetect(target, RaveFmiImage_getOriginalUndetect(self->image));
+    image->original_type = source->original_type;
+    image->bin_depth = source->bin_depth;
+    image->elevation_angle = source->elevation_angle;
+  }
+
+  switch (method) {
+  case RaveRopoRestoreMethod_FILL:
+    task = "fi.fmi.ropo.restore2";
+    fmt = "RESTORE2_THRESH: %d";
+    break;
+  case RaveRopoRestoreMethod_PYRAMID:
+    task = "fi.fmi.ropo.restore_pyramid";
+    fmt = "RESTORE_PYRAMID_THRESH: %d";
+    break;
+  default:
+    task = "fi.fmi.ropo.restore";
+    fmt = "RESTORE_THRESH: %d";
+  }
+
+  if (!RaveRopoGeneratorInternal_addTask(target, task) ||
+      !RaveRopoGeneratorInternal_addProbabilityTaskArgs(target, self->probabilities, fmt, threshold)) {
+    RAVE_CRITICAL0("Failed to add task arguments");
+    goto done;
+  }
+
+  classification = RaveFmiImage_getImage(self->classification);
+  switch (method) {
+  case RaveRopoRestoreMethod_FILL:
+    restore_image2(source, image, classification, threshold);
+    break;
+  case RaveRopoRestoreMethod_PYRAMID:
+    restore_image_pyramid(source, image, classification, threshold, self->azimuthWrap);
+    break;
+  default:
+    restore_image(source, image, classification, threshold);
+  }
+  classification->original_type=RaveDataType_UCHAR; /** Classification should always be UCHAR */
+
+  result = 1;
+done:
+  return result;
+}
+
+/**
+ * Creates a probability field without data that only holds the how/task and
+ * how/task_args attributes of the provided field.
+ * @param[in] probability - the probability field
+ * @return the placeholder on success otherwise NULL
+ */
+static RaveFmiImage_t* RaveRopoGeneratorInternal_createPlaceholder(RaveFmiImage_t* probability)
+{
+  const char* names[] = {"how/task", "how/task_args"};
+  RaveFmiImage_t* placeholder = NULL;
+  RaveFmiImage_t* result = NULL;
+  RaveAttribute_t* attr = NULL;
+  RaveAttribute_t* clone = NULL;
+  int i = 0;
+
+  placeholder = RAVE_OBJECT_NEW(&RaveFmiImage_TYPE);
+  if (placeholder == NULL) {
+    RAVE_CRITICAL0("Failed to create probability field");
+    goto done;
+  }
+  RaveFmiImage_setPgmCode(placeholder, RaveFmiImage_getPgmCode(probability));
+  for (i = 0; i < 2; i++) {
+    attr = RaveFmiImage_getAttribute(probability, names[i]);
+    if (attr != NULL) {
+      clone = RAVE_OBJECT_CLONE(attr);
+      if (clone == NULL || !RaveFmiImage_addAttribute(placeholder, clone)) {
+        RAVE_CRITICAL0("Failed to add attribute to image");
+        goto done;
+      }
+      RAVE_OBJECT_RELEASE(clone);
+    }
+    RAVE_OBJECT_RELEASE(attr);
+  }
+
+  result = RAVE_OBJECT_COPY(placeholder);
+done:
+  RAVE_OBJECT_RELEASE(attr);
+  RAVE_OBJECT_RELEASE(clone);
+  RAVE_OBJECT_RELEASE(placeholder);
+  return result;
+}
+
+/**
+ * Adds a probability field produced by a detector and merges it into the
+ * classification and markers, so that they are always up to date. If the
+ * probability fields should not be kept, only a placeholder with the task
+ * attributes is stored.
+ * @param[in] self - self
+ * @param[in] probability - the probability field
+ * @return 1 on success otherwise 0
+ */
+static int RaveRopoGeneratorInternal_addProbabilityField(RaveRopoGenerator_t* self, RaveFmiImage_t* probability)
+{
+  RaveFmiImage_t* entry = NULL;
+  int result = 0;
+
+  if (!RaveRopoGenerator_classify(self)) {
+    RAVE_ERROR0("Failed to classify image");
+    goto done;
+  }
+
+  max_image_marked(RaveFmiImage_getImage(probability),
+                   (Byte)RaveFmiImage_getPgmCode(probability),
+                   RaveFmiImage_getImage(self->classification),
+                   RaveFmiImage_getImage(self->markers));
+
+  if (self->keepProbabilities) {
+    entry = RAVE_OBJECT_COPY(probability);
+  } else {
+    entry = RaveRopoGeneratorInternal_createPlaceholder(probability);
+  }
+  if (entry == NULL || !RaveObjectList_add(self->probabilities, (RaveCoreObject*)entry)) {
+    RAVE_ERROR0("Failed to add probability field to probabilities");
+    goto done;
+  }
+  if (!self->keepProbabilities) {
+    /* The data has been merged so the field can be handed to the next detector */
+    RAVE_OBJECT_RELEASE(self->spareProbability);
+    self->spareProbability = RAVE_OBJECT_COPY(probability);
+  }
+
+  if (!RaveRopoGeneratorInternal_addProbabilityTaskArgs(self->classification, self->probabilities, "") ||
+      !RaveRopoGeneratorInternal_addProbabilityTaskArgs(self->markers, self->probabilities, "")) {
+    RAVE_CRITICAL0("Failed to add task arguments");
+    goto done;
+  }
+
+  result = 1;
+done:
+  RAVE_OBJECT_RELEASE(entry);
+  return result;
+}
+
+/**
+ * Returns if the string only contains white space.
+ * @param[in] str - the string
+ * @param[in] len - the length of the string
+ * @return 1 if str is blank otherwise 0
+ */
+static int RaveRopoGeneratorInternal_isBlank(const char* str, size_t len)
+{
+  size_t i = 0;
+  for (i = 0; i < len; i++) {
+    if (!isspace((unsigned char)str[i])) {
+      return 0;
+    }
+  }
+  return 1;
+}
+
+/**
+ * Parses one pipeline step on the form name:arg1,arg2,...
+ * @param[in] str - the step, not nul terminated
+ * @param[in] len - the length of the step
+ * @param[out] step - the parsed step
+ * @return 1 on success otherwise 0
+ */
+static int RaveRopoGeneratorInternal_parseStep(const char* str, size_t len, struct RopoGenerator_PipelineStep* step)
+{
+  char name[256];
+  char* args = NULL;
+  char* endp = NULL;
+  int nargs = 0;
+  int i = 0;
+
+  while (len > 0 && isspace((unsigned char)*str)) {
+    str++;
+    len--;
+  }
+  while (len > 0 && isspace((unsigned char)str[len - 1])) {
+    len--;
+  }
+  if (len == 0 || len >= sizeof(name)) {
+    RAVE_ERROR0("Invalid pipeline step");
+    return 0;
+  }
+  memcpy(name, str, len);
+  name[len] = '\0';
+
+  args = strchr(name, ':');
+  if (args != NULL) {
+    *args++ = '\0';
+  }
+
+  step->detector = NULL;
+  for (i = 0; DETECTOR_REGISTRY[i].name != NULL; i++) {
+    if (strcmp(DETECTOR_REGISTRY[i].name, name) == 0) {
+      step->detector = &DETECTOR_REGISTRY[i];
+      break;
+    }
+  }
+  if (step->detector == NULL) {
+    RAVE_ERROR1("Unknown detector '%s' in pipeline", name);
+    return 0;
+  }
+
+  while (args != NULL) {
+    long v = strtol(args, &endp, 10);
+    if (endp == args || nargs >= RopoGenerator_MAX_DETECTOR_ARGS) {
+      goto error;
+    }
+    step->args[nargs++] = (int)v;
+    while (isspace((unsigned char)*endp)) {
+      endp++;
+    }
+    if (*endp == ',') {
+      args = endp + 1;
+    } else if (*endp == '\0') {
+      args = NULL;
+    } else {
+      goto error;
+    }
+  }
+  if (nargs != step->detector->nargs) {
+    goto error;
+  }
+  return 1;
+error:
+  RAVE_ERROR2("Detector %s expects the arguments %s", name, step->detector->parameters);
+  return 0;
+}
 
 /*@} End of Private functions */
 
@@ -451,6 +771,7 @@ void RaveRopoGenerator_setImage(RaveRopoGenerator_t* self, RaveFmiImage_t* image
   RAVE_ASSERT((image != NULL), "image == NULL");
 
   RaveRopoGenerator_declassify(self);
+  RAVE_OBJECT_RELEASE(self->spareProbability);
   RAVE_OBJECT_RELEASE(self->image);
   self->image = RAVE_OBJECT_COPY(image);
 }
@@ -461,6 +782,30 @@ RaveFmiImage_t* RaveRopoGenerator_getImage(RaveRopoGenerator_t* self)
   return RAVE_OBJECT_COPY(self->image);
 }
 
+void RaveRopoGenerator_setAzimuthWrap(RaveRopoGenerator_t* self, int wrap)
+{
+  RAVE_ASSERT((self != NULL), "self == NULL");
+  self->azimuthWrap = wrap ? 1 : 0;
+}
+
+int RaveRopoGenerator_getAzimuthWrap(RaveRopoGenerator_t* self)
+{
+  RAVE_ASSERT((self != NULL), "self == NULL");
+  return self->azimuthWrap;
+}
+
+void RaveRopoGenerator_setKeepProbabilities(RaveRopoGenerator_t* self, int keep)
+{
+  RAVE_ASSERT((self != NULL), "self == NULL");
+  self->keepProbabilities = keep ? 1 : 0;
+}
+
+int RaveRopoGenerator_getKeepProbabilities(RaveRopoGenerator_t* self)
+{
+  RAVE_ASSERT((self != NULL), "self == NULL");
+  return self->keepProbabilities;
+}
+
 void RaveRopoGenerator_threshold(RaveRopoGenerator_t* self, int threshold)
 {
   RAVE_ASSERT((self != NULL), "self == NULL");
@@ -483,26 +828,25 @@ int RaveRopoGenerator_speck(RaveRopoGenerator_t* self, int minDbz, int maxA)
 
   if (!RaveRopoGeneratorInternal_createProbabilityField(self,
          &probability,
+         RopoGenerator_SPECK,
          "fi.fmi.ropo.detector",
          "SPECK: %d,%d",minDbz, maxA)) {
     goto done;
   }
 
-  detect_specks(RaveFmiImage_getImage(self->image),
-                RaveFmiImage_getImage(probability),
-                RaveRopoGeneratorInternal_valueToByteRange(minDbz, self->image),
-                histogram_area);
+  detect_specks_wrap(RaveFmiImage_getImage(self->image),
+                     RaveFmiImage_getImage(probability),
+                     RaveRopoGeneratorInternal_valueToByteRange(minDbz, self->image),
+                     histogram_area,
+                     self->azimuthWrap);
   semisigmoid_image(RaveFmiImage_getImage(probability), maxA);
   invert_image(RaveFmiImage_getImage(probability));
   translate_intensity(RaveFmiImage_getImage(probability), 255, 0);
 
-  if (!RaveObjectList_add(self->probabilities, (RaveCoreObject*)probability)) {
-    RAVE_ERROR0("Failed to add probability field to probabilities");
+  if (!RaveRopoGeneratorInternal_addProbabilityField(self, probability)) {
     goto done;
   }
 
-  RaveRopoGeneratorInternal_removeClassifications(self);
-
   result = 1;
 done:
   RAVE_OBJECT_RELEASE(probability);
@@ -517,27 +861,26 @@ int RaveRopoGenerator_speckNormOld(RaveRopoGenerator_t* self, int minDbz, int ma
 
   if (!RaveRopoGeneratorInternal_createProbabilityField(self,
          &probability,
+         RopoGenerator_SPECKNORMOLD,
          "fi.fmi.ropo.detector",
          "SPECKNORMOLD: %d,%d,%d",minDbz, maxA, maxN)) {
     goto done;
   }
 
-  detect_specks(RaveFmiImage_getImage(self->image),
-		  	    RaveFmiImage_getImage(probability),
-		  	    RaveRopoGeneratorInternal_valueToByteRange(minDbz, self->image),
-		  	    histogram_area);
+  detect_specks_wrap(RaveFmiImage_getImage(self->image),
+                     RaveFmiImage_getImage(probability),
+                     RaveRopoGeneratorInternal_valueToByteRange(minDbz, self->image),
+                     histogram_area,
+                     self->azimuthWrap);
   distance_compensation_mul(RaveFmiImage_getImage(probability), maxN);
   semisigmoid_image(RaveFmiImage_getImage(probability),maxA);
   invert_image(RaveFmiImage_getImage(probability));
   translate_intensity(RaveFmiImage_getImage(probability),255,0);
 
-  if (!RaveObjectList_add(self->probabilities, (RaveCoreObject*)probability)) {
-    RAVE_ERROR0("Failed to add probability field to probabilities");
+  if (!RaveRopoGeneratorInternal_addProbabilityField(self, probability)) {
     goto done;
   }
 
-  RaveRopoGeneratorInternal_removeClassifications(self);
-
   result = 1;
 done:
   RAVE_OBJECT_RELEASE(probability);
@@ -552,6 +895,7 @@ int RaveRopoGenerator_emitter(RaveRopoGenerator_t* self, int minDbz, int length)
 
   if (!RaveRopoGeneratorInternal_createProbabilityField(self,
          &probability,
+         RopoGenerator_EMITTER,
          "fi.fmi.ropo.detector",
          "EMITTER: %d,%d",minDbz, length)) {
     goto done;
@@ -561,13 +905,10 @@ int RaveRopoGenerator_emitter(RaveRopoGenerator_t* self, int minDbz, int length)
                   RaveFmiImage_getImage(probability),
                   RaveRopoGeneratorInternal_valueToByteRange(minDbz, self->image), length);
 
-  if (!RaveObjectList_add(self->probabilities, (RaveCoreObject*)probability)) {
-    RAVE_ERROR0("Failed to add probability field to probabilities");
+  if (!RaveRopoGeneratorInternal_addProbabilityField(self, probability)) {
     goto done;
   }
 
-  RaveRopoGeneratorInternal_removeClassifications(self);
-
   result = 1;
 done:
   RAVE_OBJECT_RELEASE(probability);
@@ -582,6 +923,7 @@ int RaveRopoGenerator_emitter2(RaveRopoGenerator_t* self, int minDbz, int length
 
   if (!RaveRopoGeneratorInternal_createProbabilityField(self,
          &probability,
+         RopoGenerator_EMITTER2,
          "fi.fmi.ropo.detector",
          "EMITTER2: %d,%d,%d",minDbz, length, width)) {
     goto done;
@@ -593,13 +935,10 @@ int RaveRopoGenerator_emitter2(RaveRopoGenerator_t* self, int minDbz, int length
                    length,
                    width);
 
-  if (!RaveObjectList_add(self->probabilities, (RaveCoreObject*)probability)) {
-    RAVE_ERROR0("Failed to add probability field to probabilities");
+  if (!RaveRopoGeneratorInternal_addProbabilityField(self, probability)) {
     goto done;
   }
 
-  RaveRopoGeneratorInternal_removeClassifications(self);
-
   result = 1;
 done:
   RAVE_OBJECT_RELEASE(probability);
@@ -614,26 +953,25 @@ int RaveRopoGenerator_clutter(RaveRopoGenerator_t* self, int minDbz, int maxComp
 
   if (!RaveRopoGeneratorInternal_createProbabilityField(self,
          &probability,
+         RopoGenerator_CLUTTER,
          "fi.fmi.ropo.detector",
          "CLUTTER: %d,%d",minDbz, maxCompactness)) {
     goto done;
   }
 
-  detect_specks(RaveFmiImage_getImage(self->image),
-                RaveFmiImage_getImage(probability),
-                RaveRopoGeneratorInternal_valueToByteRange(minDbz, self->image),
-                histogram_compactness);
+  detect_specks_wrap(RaveFmiImage_getImage(self->image),
+                     RaveFmiImage_getImage(probability),
+                     RaveRopoGeneratorInternal_valueToByteRange(minDbz, self->image),
+                     histogram_compactness,
+                     self->azimuthWrap);
   semisigmoid_image(RaveFmiImage_getImage(probability),maxCompactness);
   invert_image(RaveFmiImage_getImage(probability));
   translate_intensity(RaveFmiImage_getImage(probability),255,0);
 
-  if (!RaveObjectList_add(self->probabilities, (RaveCoreObject*)probability)) {
-    RAVE_ERROR0("Failed to add probability field to probabilities");
+  if (!RaveRopoGeneratorInternal_addProbabilityField(self, probability)) {
     goto done;
   }
 
-  RaveRopoGeneratorInternal_removeClassifications(self);
-
   result = 1;
 done:
   RAVE_OBJECT_RELEASE(probability);
@@ -648,26 +986,25 @@ int RaveRopoGenerator_clutter2(RaveRopoGenerator_t* self, int minDbz, int maxSmo
 
   if (!RaveRopoGeneratorInternal_createProbabilityField(self,
          &probability,
+         RopoGenerator_CLUTTER2,
          "fi.fmi.ropo.detector",
          "CLUTTER2: %d,%d",minDbz, maxSmoothness)) {
     goto done;
   }
 
-  detect_specks(RaveFmiImage_getImage(self->image),
-                RaveFmiImage_getImage(probability),
-                RaveRopoGeneratorInternal_valueToByteRange(minDbz, self->image),
-                histogram_smoothness);
+  detect_specks_wrap(RaveFmiImage_getImage(self->image),
+                     RaveFmiImage_getImage(probability),
+                     RaveRopoGeneratorInternal_valueToByteRange(minDbz, self->image),
+                     histogram_smoothness,
+                     self->azimuthWrap);
   invert_image(RaveFmiImage_getImage(probability));
   translate_intensity(RaveFmiImage_getImage(probability),255,0);
   semisigmoid_image(RaveFmiImage_getImage(probability),255-maxSmoothness);
 
-  if (!RaveObjectList_add(self->probabilities, (RaveCoreObject*)probability)) {
-    RAVE_ERROR0("Failed to add probability field to probabilities");
+  if (!RaveRopoGeneratorInternal_addProbabilityField(self, probability)) {
     goto done;
   }
 
-  RaveRopoGeneratorInternal_removeClassifications(self);
-
   result = 1;
 done:
   RAVE_OBJECT_RELEASE(probability);
@@ -682,6 +1019,7 @@ int RaveRopoGenerator_softcut(RaveRopoGenerator_t* self, int maxDbz, int r, int
 
   if (!RaveRopoGeneratorInternal_createProbabilityField(self,
          &probability,
+         RopoGenerator_SOFTCUT,
          "fi.fmi.ropo.detector",
          "SOFTCUT: %d,%d,%d",maxDbz, r, r2)) {
     goto done;
@@ -692,13 +1030,10 @@ int RaveRopoGenerator_softcut(RaveRopoGenerator_t* self, int maxDbz, int r, int
                      RaveRopoGeneratorInternal_valueToByteRange(maxDbz, self->image),
                      r, r2);
 
-  if (!RaveObjectList_add(self->probabilities, (RaveCoreObject*)probability)) {
-    RAVE_ERROR0("Failed to add probability field to probabilities");
+  if (!RaveRopoGeneratorInternal_addProbabilityField(self, probability)) {
     goto done;
   }
 
-  RaveRopoGeneratorInternal_removeClassifications(self);
-
   result = 1;
 done:
   RAVE_OBJECT_RELEASE(probability);
@@ -713,6 +1048,7 @@ int RaveRopoGenerator_biomet(RaveRopoGenerator_t* self, int maxDbz, int dbzDelta
 
   if (!RaveRopoGeneratorInternal_createProbabilityField(self,
          &probability,
+         RopoGenerator_BIOMET,
          "fi.fmi.ropo.detector",
          "BIOMET: %d,%d,%d,%d",maxDbz, dbzDelta, maxAlt, altDelta)) {
     goto done;
@@ -725,13 +1061,10 @@ int RaveRopoGenerator_biomet(RaveRopoGenerator_t* self, int maxDbz, int dbzDelta
                 maxAlt,
                 altDelta);
 
-  if (!RaveObjectList_add(self->probabilities, (RaveCoreObject*)probability)) {
-    RAVE_ERROR0("Failed to add probability field to probabilities");
+  if (!RaveRopoGeneratorInternal_addProbabilityField(self, probability)) {
     goto done;
   }
 
-  RaveRopoGeneratorInternal_removeClassifications(self);
-
   result = 1;
 done:
   RAVE_OBJECT_RELEASE(probability);
@@ -746,6 +1079,7 @@ int RaveRopoGenerator_ship(RaveRopoGenerator_t* self, int minRelDbz, int minA)
 
   if (!RaveRopoGeneratorInternal_createProbabilityField(self,
          &probability,
+         RopoGenerator_SHIP,
          "fi.fmi.ropo.detector",
          "SHIP: %d,%d",minRelDbz, minA)) {
     goto done;
@@ -756,13 +1090,10 @@ int RaveRopoGenerator_ship(RaveRopoGenerator_t* self, int minRelDbz, int minA)
                RaveRopoGeneratorInternal_relValueToByteRange(minRelDbz, self->image),
                minA);
 
-  if (!RaveObjectList_add(self->probabilities, (RaveCoreObject*)probability)) {
-    RAVE_ERROR0("Failed to add probability field to probabilities");
+  if (!RaveRopoGeneratorInternal_addProbabilityField(self, probability)) {
     goto done;
   }
 
-  RaveRopoGeneratorInternal_removeClassifications(self);
-
   result = 1;
 done:
   RAVE_OBJECT_RELEASE(probability);
@@ -777,6 +1108,7 @@ int RaveRopoGenerator_sun(RaveRopoGenerator_t* self, int minDbz, int minLength,
 
   if (!RaveRopoGeneratorInternal_createProbabilityField(self,
          &probability,
+         RopoGenerator_SUN,
          "fi.fmi.ropo.detector",
          "SUN: %d,%d,%d", minDbz, minLength, maxThickness)) {
     goto done;
@@ -788,13 +1120,10 @@ int RaveRopoGenerator_sun(RaveRopoGenerator_t* self, int minDbz, int minLength,
              maxThickness,
              minLength);
 
-  if (!RaveObjectList_add(self->probabilities, (RaveCoreObject*)probability)) {
-    RAVE_ERROR0("Failed to add probability field to probabilities");
+  if (!RaveRopoGeneratorInternal_addProbabilityField(self, probability)) {
     goto done;
   }
 
-  RaveRopoGeneratorInternal_removeClassifications(self);
-
   result = 1;
 done:
   RAVE_OBJECT_RELEASE(probability);
@@ -809,6 +1138,7 @@ int RaveRopoGenerator_sun2(RaveRopoGenerator_t* self, int minDbz, int minLength,
 
   if (!RaveRopoGeneratorInternal_createProbabilityField(self,
          &probability,
+         RopoGenerator_SUN2,
          "fi.fmi.ropo.detector",
          "SUN2: %d,%d,%d,%d,%d", minDbz, minLength, maxThickness,azimuth,elevation)) {
     goto done;
@@ -822,19 +1152,99 @@ int RaveRopoGenerator_sun2(RaveRopoGenerator_t* self, int minDbz, int minLength,
               azimuth,
               elevation);
 
-  if (!RaveObjectList_add(self->probabilities, (RaveCoreObject*)probability)) {
-    RAVE_ERROR0("Failed to add probability field to probabilities");
+  if (!RaveRopoGeneratorInternal_addProbabilityField(self, probability)) {
     goto done;
   }
 
-  RaveRopoGeneratorInternal_removeClassifications(self);
-
   result = 1;
 done:
   RAVE_OBJECT_RELEASE(probability);
   return result;
 }
 
+int RaveRopoGenerator_run(RaveRopoGenerator_t* self, const char* pipeline)
+{
+  struct RopoGenerator_PipelineStep* steps = NULL;
+  const char* start = NULL;
+  const char* end = NULL;
+  int nsteps = 0, i = 0;
+  int result = 0;
+
+  RAVE_ASSERT((self != NULL), "self == NULL");
+  RAVE_ASSERT((pipeline != NULL), "pipeline == NULL");
+
+  for (start = pipeline; start != NULL; start = (*end == ';') ? end + 1 : NULL) {
+    end = strchr(start, ';');
+    if (end == NULL) {
+      end = start + strlen(start);
+    }
+    nsteps++;
+  }
+
+  steps = RAVE_MALLOC(sizeof(struct RopoGenerator_PipelineStep) * nsteps);
+  if (steps == NULL) {
+    RAVE_CRITICAL0("Failed to allocate memory for pipeline");
+    goto done;
+  }
+
+  /* Validate the whole pipeline before running anything */
+  nsteps = 0;
+  for (start = pipeline; start != NULL; start = (*end == ';') ? end + 1 : NULL) {
+    end = strchr(start, ';');
+    if (end == NULL) {
+      end = start + strlen(start);
+    }
+    if (RaveRopoGeneratorInternal_isBlank(start, end - start)) {
+      continue;
+    }
+    if (!RaveRopoGeneratorInternal_parseStep(start, end - start, &steps[nsteps])) {
+      goto done;
+    }
+    nsteps++;
+  }
+
+  for (i = 0; i < nsteps; i++) {
+    if (!steps[i].detector->run(self, steps[i].args)) {
+      RAVE_ERROR1("Failed to run detector %s", steps[i].detector->name);
+      goto done;
+    }
+  }
+
+  result = 1;
+done:
+  RAVE_FREE(steps);
+  return result;
+}
+
+int RaveRopoGenerator_getDetectorCount(void)
+{
+  return RopoGenerator_DETECTOR_COUNT;
+}
+
+const char* RaveRopoGenerator_getDetectorName(int index)
+{
+  if (index < 0 || index >= RaveRopoGenerator_getDetectorCount()) {
+    return NULL;
+  }
+  return DETECTOR_REGISTRY[index].name;
+}
+
+const char* RaveRopoGenerator_getDetectorParameters(int index)
+{
+  if (index < 0 || index >= RaveRopoGenerator_getDetectorCount()) {
+    return NULL;
+  }
+  return DETECTOR_REGISTRY[index].parameters;
+}
+
+FmiRadarPGMCode RaveRopoGenerator_getDetectorPgmCode(int index)
+{
+  if (index < 0 || index >= RaveRopoGenerator_getDetectorCount()) {
+    return CLEAR;
+  }
+  return DETECTOR_REGISTRY[index].code;
+}
+
 int RaveRopoGenerator_classify(RaveRopoGenerator_t* self)
 {
   RaveFmiImage_t* probability = NULL;
@@ -842,6 +1252,8 @@ int RaveRopoGenerator_classify(RaveRopoGenerator_t* self)
   FmiImage* fmiProbImage = NULL;
   FmiImage* fmiMarkersImage = NULL;
   RaveAttribute_t* attribute = NULL;
+  FmiImage** probImages = NULL;
+  Byte* pgmCodes = NULL;
   int result = 0;
   int probCount = 0;
   int i = 0;
@@ -853,6 +1265,11 @@ int RaveRopoGenerator_classify(RaveRopoGenerator_t* self)
     goto done;
   }
 
+  if (self->classification != NULL && self->markers != NULL) {
+    /* Kept up to date as the detectors are run */
+    return 1;
+  }
+
   probability = RAVE_OBJECT_CLONE(self->image);
   markers = RAVE_OBJECT_CLONE(self->image);
   if (probability == NULL || markers == NULL) {
@@ -863,29 +1280,31 @@ int RaveRopoGenerator_classify(RaveRopoGenerator_t* self)
   RaveFmiImage_getImage(probability)->original_type = RaveDataType_UCHAR; /* We want the probability and markers field to be of UCHAR type */
   RaveFmiImage_getImage(markers)->original_type = RaveDataType_UCHAR;
 
-  RaveFmiImage_fill(probability, CLEAR);
-  RaveFmiImage_fill(markers, CLEAR);
-
   probCount = RaveObjectList_size(self->probabilities);
 
   fmiProbImage = RaveFmiImage_getImage(probability);
   fmiMarkersImage = RaveFmiImage_getImage(markers);
 
-
-  for (i = 0; i < probCount; i++) {
-    int j = 0;
-    RaveFmiImage_t* image = (RaveFmiImage_t*)RaveObjectList_get(self->probabilities, i);
-    FmiImage* probImage = RaveFmiImage_getImage(image);
-    FmiRadarPGMCode pgmCode = RaveRopoGeneratorInternal_getPgmCode(image);
-
-    for (j = 0; j < fmiProbImage->volume; j++) {
-      if (probImage->array[j] >= fmiProbImage->array[j]) {
-        /*fprintf(stderr, "Setting fmiProbImage(%d) = %d\n", j, probImage->array[j]); //printout of probablitity value*/
-        fmiMarkersImage->array[j]=pgmCode;
-        fmiProbImage->array[j]=probImage->array[j];
-      }
+  if (probCount == 0) {
+    RaveFmiImage_fill(probability, CLEAR);
+    RaveFmiImage_fill(markers, CLEAR);
+  } else {
+    /* One pass over all probability fields, the latest field wins on ties */
+    probImages = (FmiImage**)RAVE_MALLOC(sizeof(FmiImage*) * probCount);
+    pgmCodes = (Byte*)RAVE_MALLOC(sizeof(Byte) * probCount);
+    if (probImages == NULL || pgmCodes == NULL) {
+      RAVE_CRITICAL0("Failed to allocate memory");
+      goto done;
     }
-    RAVE_OBJECT_RELEASE(image);
+    for (i = 0; i < probCount; i++) {
+      RaveFmiImage_t* image = (RaveFmiImage_t*)RaveObjectList_get(self->probabilities, i);
+      probImages[i] = RaveFmiImage_getImage(image); /* the list keeps the field alive */
+      pgmCodes[i] = (Byte)RaveFmiImage_getPgmCode(image);
+      RAVE_OBJECT_RELEASE(image);
+    }
+    max_images_marked(probImages, pgmCodes, probCount, fmiProbImage, fmiMarkersImage);
+    RaveFmiImage_fillOriginal(probability, CLEAR);
+    RaveFmiImage_fillOriginal(markers, CLEAR);
   }
   /*fprintf(stderr, "TYPE: %d\n", RaveFmiImage_getImage(probability)->original_type);*/
   if (!RaveRopoGeneratorInternal_addTask(probability, "fi.fmi.ropo.detector.classification") ||
@@ -925,6 +1344,8 @@ done:
   RAVE_OBJECT_RELEASE(attribute);
   RAVE_OBJECT_RELEASE(probability);
   RAVE_OBJECT_RELEASE(markers);
+  RAVE_FREE(probImages);
+  RAVE_FREE(pgmCodes);
   return result;
 }
 
@@ -943,31 +1364,16 @@ RaveFmiImage_t* RaveRopoGenerator_restore(RaveRopoGenerator_t* self, int thresho
 
   RAVE_ASSERT((self != NULL), "self == NULL");
 
-  if (self->classification == NULL || self->markers == NULL) {
-    RaveRopoGenerator_classify(self);
-  }
-
   restored = RAVE_OBJECT_CLONE(self->image);
   if (restored == NULL) {
     RAVE_CRITICAL0("Failed to clone image");
     goto done;
   }
 
-  RaveFmiImage_fill(restored, CLEAR);
-  RaveFmiImage_fillOriginal(restored, (double)CLEAR);
-
-  if (!RaveRopoGeneratorInternal_addTask(restored, "fi.fmi.ropo.restore") ||
-      !RaveRopoGeneratorInternal_addProbabilityTaskArgs(restored, self->probabilities, "RESTORE_THRESH: %d",threshold)) {
-    RAVE_CRITICAL0("Failed to add task arguments");
+  if (!RaveRopoGeneratorInternal_restore(self, restored, threshold, RaveRopoRestoreMethod_ERASE)) {
     goto done;
   }
 
-  restore_image(RaveFmiImage_getImage(self->image),
-                RaveFmiImage_getImage(restored),
-                RaveFmiImage_getImage(self->classification),
-                threshold);
-  RaveFmiImage_getImage(self->classification)->original_type=RaveDataType_UCHAR; /** Classification should always be UCHAR */
-
   result = RAVE_OBJECT_COPY(restored);
 done:
   RAVE_OBJECT_RELEASE(restored);
@@ -981,29 +1387,38 @@ RaveFmiImage_t* RaveRopoGenerator_restore2(RaveRopoGenerator_t* self, int thresh
 
   RAVE_ASSERT((self != NULL), "self == NULL");
 
-  if (self->classification == NULL || self->markers == NULL) {
-    RaveRopoGenerator_classify(self);
-  }
   restored = RAVE_OBJECT_CLONE(self->image);
   if (restored == NULL) {
     RAVE_CRITICAL0("Failed to clone image");
     goto done;
   }
 
-  RaveFmiImage_fill(restored, CLEAR);
-  RaveFmiImage_fillOriginal(restored, (double)CLEAR);
+  if (!RaveRopoGeneratorInternal_restore(self, restored, threshold, RaveRopoRestoreMethod_FILL)) {
+    goto done;
+  }
 
-  if (!RaveRopoGeneratorInternal_addTask(restored, "fi.fmi.ropo.restore2") ||
-      !RaveRopoGeneratorInternal_addProbabilityTaskArgs(restored, self->probabilities, "RESTORE2_THRESH: %d",threshold)) {
-    RAVE_CRITICAL0("Failed to add task arguments");
+  result = RAVE_OBJECT_COPY(restored);
+done:
+  RAVE_OBJECT_RELEASE(restored);
+  return result;
+}
+
+RaveFmiImage_t* RaveRopoGenerator_restorePyramid(RaveRopoGenerator_t* self, int threshold)
+{
+  RaveFmiImage_t* restored = NULL;
+  RaveFmiImage_t* result = NULL;
+
+  RAVE_ASSERT((self != NULL), "self == NULL");
+
+  restored = RAVE_OBJECT_CLONE(self->image);
+  if (restored == NULL) {
+    RAVE_CRITICAL0("Failed to clone image");
     goto done;
   }
 
-  restore_image2(RaveFmiImage_getImage(self->image),
-                 RaveFmiImage_getImage(restored),
-                 RaveFmiImage_getImage(self->classification),
-                 threshold);
-  RaveFmiImage_getImage(self->classification)->original_type=RaveDataType_UCHAR; /** Classification should always be UCHAR */
+  if (!RaveRopoGeneratorInternal_restore(self, restored, threshold, RaveRopoRestoreMethod_PYRAMID)) {
+    goto done;
+  }
 
   result = RAVE_OBJECT_COPY(restored);
 done:
@@ -1011,29 +1426,148 @@ done:
   return result;
 }
 
-int RaveRopoGenerator_restoreSelf(RaveRopoGenerator_t* self, int threshold)
+RaveObjectList_t* RaveRopoGenerator_restoreThresholds(RaveRopoGenerator_t* self, const int* thresholds, int count, double* fractions)
 {
-  RaveFmiImage_t* restored = NULL;
-  int result = 0;
+  RaveObjectList_t* restored = NULL;
+  RaveObjectList_t* result = NULL;
+  RaveFmiImage_t* image = NULL;
+  FmiImage** targets = NULL;
+  Byte* bthresholds = NULL;
+  long int* removed = NULL;
+  long int detected = 0;
+  int i = 0;
 
   RAVE_ASSERT((self != NULL), "self == NULL");
+  RAVE_ASSERT((thresholds != NULL || count == 0), "thresholds == NULL");
+
+  if (RaveFmiImage_getImage(self->image)->original == NULL) {
+    RAVE_ERROR0("Restore needs original data in the image, probability fields have none");
+    return NULL;
+  }
 
-  restored = RaveRopoGenerator_restore(self, threshold);
+  if (self->classification == NULL || self->markers == NULL) {
+    RaveRopoGenerator_classify(self);
+  }
 
-  if (restored == NULL) {
-    RAVE_ERROR0("Failed to restore self");
+  restored = RAVE_OBJECT_NEW(&RaveObjectList_TYPE);
+  targets = (FmiImage**)RAVE_MALLOC(sizeof(FmiImage*) * (count + 1));
+  bthresholds = (Byte*)RAVE_MALLOC(sizeof(Byte) * (count + 1));
+  removed = (long int*)RAVE_MALLOC(sizeof(long int) * (count + 1));
+  if (restored == NULL || targets == NULL || bthresholds == NULL || removed == NULL) {
+    RAVE_CRITICAL0("Failed to allocate memory");
     goto done;
   }
 
-  RAVE_OBJECT_RELEASE(self->image);
-  self->image = RAVE_OBJECT_COPY(restored);
+  for (i = 0; i < count; i++) {
+    image = RAVE_OBJECT_CLONE(self->image);
+    if (image == NULL) {
+      RAVE_CRITICAL0("Failed to clone image");
+      goto done;
+    }
+    if (!RaveRopoGeneratorInternal_addTask(image, "fi.fmi.ropo.restore") ||
+        !RaveRopoGeneratorInternal_addProbabilityTaskArgs(image, self->probabilities, "RESTORE_THRESH: %d", thresholds[i])) {
+      RAVE_CRITICAL0("Failed to add task arguments");
+      goto done;
+    }
+    if (!RaveObjectList_add(restored, (RaveCoreObject*)image)) {
+      RAVE_CRITICAL0("Failed to add image to list");
+      goto done;
+    }
+    targets[i] = RaveFmiImage_getImage(image);
+    bthresholds[i] = (Byte)thresholds[i];
+    RAVE_OBJECT_RELEASE(image);
+  }
 
-  result = 1;
+  restore_image_thresholds(RaveFmiImage_getImage(self->image),
+                           targets,
+                           RaveFmiImage_getImage(self->classification),
+                           bthresholds, count, removed, &detected);
+  RaveFmiImage_getImage(self->classification)->original_type=RaveDataType_UCHAR; /** Classification should always be UCHAR */
+
+  if (fractions != NULL) {
+    for (i = 0; i < count; i++) {
+      fractions[i] = (detected > 0) ? (double)removed[i] / (double)detected : 0.0;
+    }
+  }
+
+  result = RAVE_OBJECT_COPY(restored);
 done:
+  RAVE_OBJECT_RELEASE(image);
   RAVE_OBJECT_RELEASE(restored);
+  RAVE_FREE(targets);
+  RAVE_FREE(bthresholds);
+  RAVE_FREE(removed);
   return result;
 }
 
+int RaveRopoGenerator_restoreInto(RaveRopoGenerator_t* self, RaveFmiImage_t* target, int threshold)
+{
+  RAVE_ASSERT((self != NULL), "self == NULL");
+  RAVE_ASSERT((target != NULL), "target == NULL");
+  return RaveRopoGeneratorInternal_restore(self, target, threshold, RaveRopoRestoreMethod_ERASE);
+}
+
+int RaveRopoGenerator_restore2Into(RaveRopoGenerator_t* self, RaveFmiImage_t* target, int threshold)
+{
+  RAVE_ASSERT((self != NULL), "self == NULL");
+  RAVE_ASSERT((target != NULL), "target == NULL");
+  return RaveRopoGeneratorInternal_restore(self, target, threshold, RaveRopoRestoreMethod_FILL);
+}
+
+int RaveRopoGenerator_restorePyramidInto(RaveRopoGenerator_t* self, RaveFmiImage_t* target, int threshold)
+{
+  RAVE_ASSERT((self != NULL), "self == NULL");
+  RAVE_ASSERT((target != NULL), "target == NULL");
+  return RaveRopoGeneratorInternal_restore(self, target, threshold, RaveRopoRestoreMethod_PYRAMID);
+}
+
+int RaveRopoGenerator_restoreParameter(RaveRopoGenerator_t* self, PolarScanParam_t* param, int threshold)
+{
+  FmiImage* classification = NULL;
+  double undetect = 0.0;
+  int ray = 0, bin = 0;
+  Byte* row = NULL;
+
+  RAVE_ASSERT((self != NULL), "self == NULL");
+  RAVE_ASSERT((param != NULL), "param == NULL");
+
+  if (self->classification == NULL || self->markers == NULL) {
+    if (!RaveRopoGenerator_classify(self)) {
+      RAVE_ERROR0("Failed to classify image");
+      return 0;
+    }
+  }
+  classification = RaveFmiImage_getImage(self->classification);
+
+  if (PolarScanParam_getNbins(param) != classification->width ||
+      PolarScanParam_getNrays(param) != classification->height) {
+    RAVE_ERROR0("Parameter dimensions differ from the image dimensions");
+    return 0;
+  }
+
+  undetect = PolarScanParam_getUndetect(param);
+  for (ray = 0; ray < classification->height; ray++) {
+    row = &classification->array[ray * classification->width];
+    for (bin = 0; bin < classification->width; bin++) {
+      if (row[bin] >= threshold) {
+        PolarScanParam_setValue(param, bin, ray, undetect);
+      }
+    }
+  }
+  return 1;
+}
+
+int RaveRopoGenerator_restoreSelf(RaveRopoGenerator_t* self, int threshold)
+{
+  RAVE_ASSERT((self != NULL), "self == NULL");
+
+  if (!RaveRopoGeneratorInternal_restore(self, self->image, threshold, RaveRopoRestoreMethod_ERASE)) {
+    RAVE_ERROR0("Failed to restore self");
+    return 0;
+  }
+  return 1;
+}
+
 int RaveRopoGenerator_getProbabilityFieldCount(RaveRopoGenerator_t* self)
 {
   RAVE_ASSERT((self != NULL), "self == NULL");
@@ -1047,6 +1581,10 @@ RaveFmiImage_t* RaveRopoGenerator_getProbabilityField(RaveRopoGenerator_t* self,
   RAVE_ASSERT((self != NULL), "self == NULL");
 
   object = RaveObjectList_get(self->probabilities, index);
+  if (object != NULL && RaveFmiImage_getImage((RaveFmiImage_t*)object)->array == NULL) {
+    /* placeholder of a field that was not kept */
+    RAVE_OBJECT_RELEASE(object);
+  }
 
   return (RaveFmiImage_t*)object;
 }
@@ -29,6 +29,7 @@ along with bRopo.  If not, see <http://www.gnu.org/licenses/>.
 
 #include "rave_fmi_image.h"
 #include "rave_object.h"
+#include "raveobject_list.h"
 
 /**
  * Defines a RaveRopoGenerator
@@ -55,6 +56,39 @@ void RaveRopoGenerator_setImage(RaveRopoGenerator_t* self, RaveFmiImage_t* image
  */
 RaveFmiImage_t* RaveRopoGenerator_getImage(RaveRopoGenerator_t* self);
 
+/**
+ * Sets if the first and last ray of the image should be treated as neighbours
+ * (full 360 degree sweep) by the speck detectors. Default is 0.
+ * @param[in] self - self
+ * @param[in] wrap - 1 if azimuth should be wrapped, otherwise 0
+ */
+void RaveRopoGenerator_setAzimuthWrap(RaveRopoGenerator_t* self, int wrap);
+
+/**
+ * Returns if azimuth wrapping is used by the speck detectors.
+ * @param[in] self - self
+ * @return 1 if azimuth is wrapped, otherwise 0
+ */
+int RaveRopoGenerator_getAzimuthWrap(RaveRopoGenerator_t* self);
+
+/**
+ * Sets if the probability fields should be kept after they have been merged into
+ * the classification. If not, only the task attributes of each detector are kept
+ * and \ref RaveRopoGenerator_getProbabilityField returns NULL for those fields.
+ * The fields are still counted by \ref RaveRopoGenerator_getProbabilityFieldCount.
+ * Default is 1.
+ * @param[in] self - self
+ * @param[in] keep - 1 if the probability fields should be kept, otherwise 0
+ */
+void RaveRopoGenerator_setKeepProbabilities(RaveRopoGenerator_t* self, int keep);
+
+/**
+ * Returns if the probability fields are kept.
+ * @param[in] self - self
+ * @return 1 if the probability fields are kept, otherwise 0
+ */
+int RaveRopoGenerator_getKeepProbabilities(RaveRopoGenerator_t* self);
+
 /**
  * This will force a thresholding on the image. This will affect the image
  * it self and is not recoverable.
@@ -196,7 +230,51 @@ int RaveRopoGenerator_sun(RaveRopoGenerator_t* self, int minDbz, int minLength,
 int RaveRopoGenerator_sun2(RaveRopoGenerator_t* self, int minDbz, int minLength, int maxThickness, int azimuth, int elevation);
 
 /**
- * Updates the classifications with the currently kept probability fields
+ * Runs a pipeline of detectors in one call. The pipeline is a list of detector
+ * steps separated by ';' where each step is the detector name followed by ':' and
+ * its comma separated integer arguments, e.g. "speck:-30,12;emitter2:-10,3,3".
+ * The names and arguments are the same as for the individual detector functions,
+ * see \ref RaveRopoGenerator_getDetectorName. The whole pipeline is validated
+ * before any detector is run and the steps are run in the given order.
+ * @param[in] self - self
+ * @param[in] pipeline - the pipeline
+ * @return 1 on success otherwise 0
+ */
+int RaveRopoGenerator_run(RaveRopoGenerator_t* self, const char* pipeline);
+
+/**
+ * Returns the number of detectors that can be used in a pipeline.
+ * @return the number of registered detectors
+ */
+int RaveRopoGenerator_getDetectorCount(void);
+
+/**
+ * Returns the pipeline name of a registered detector.
+ * @param[in] index - the index of the detector
+ * @return the name or NULL if index is out of range
+ */
+const char* RaveRopoGenerator_getDetectorName(int index);
+
+/**
+ * Returns the parameter names of a registered detector as a comma separated
+ * string, e.g. "minDbz,maxA".
+ * @param[in] index - the index of the detector
+ * @return the parameter names or NULL if index is out of range
+ */
+const char* RaveRopoGenerator_getDetectorParameters(int index);
+
+/**
+ * Returns the pgm code that marks the probability field of a registered detector
+ * in the classification markers.
+ * @param[in] index - the index of the detector
+ * @return the pgm code or CLEAR if index is out of range
+ */
+FmiRadarPGMCode RaveRopoGenerator_getDetectorPgmCode(int index);
+
+/**
+ * Updates the classifications with the currently kept probability fields.
+ * The classification and markers are updated as each detector is run, so
+ * this only computes them if they are missing.
  * @param[in] self - self
  * @return 1 on success otherwise 0
  */
@@ -228,9 +306,75 @@ RaveFmiImage_t* RaveRopoGenerator_restore(RaveRopoGenerator_t* self, int thresho
 RaveFmiImage_t* RaveRopoGenerator_restore2(RaveRopoGenerator_t* self, int threshold);
 
 /**
- * Restores self. Basically the same as \ref RaveRopoGenerator_restore followed
+ * Creates a restored image according to the classification table, filling in
+ * anomalies of any size by interpolating the surrounding data over an image pyramid.
+ * A filled gate gets the mean of the detected data around it if most of that data
+ * is detected, otherwise undetect. Uses the azimuth wrap setting of the generator.
+ * @param[in] self - self
+ * @param[in] threshold - the probability threshold
+ * @return the restored image.
+ */
+RaveFmiImage_t* RaveRopoGenerator_restorePyramid(RaveRopoGenerator_t* self, int threshold);
+
+/**
+ * Creates one restored image per threshold, as \ref RaveRopoGenerator_restore
+ * would, in a single pass over the image and the classification.
+ * @param[in] self - self
+ * @param[in] thresholds - the probability thresholds
+ * @param[in] count - the number of thresholds
+ * @param[out] fractions - if not NULL, receives per threshold the fraction of the
+ * detected (nonzero) gates that were removed. Must hold count values.
+ * @return a list of the restored images in threshold order on success otherwise NULL
+ */
+RaveObjectList_t* RaveRopoGenerator_restoreThresholds(RaveRopoGenerator_t* self, const int* thresholds, int count, double* fractions);
+
+/**
+ * Restores the image into a caller-supplied image according to the classification
+ * table, without cloning. The target must have the same dimensions as the generator
+ * image and is overwritten completely, so it can be reused between scans. If target
+ * is the generator image itself, the image is restored in place.
+ * @param[in] self - self
+ * @param[in] target - the image to write the restored data into
+ * @param[in] threshold - the probability threshold
+ * @return 1 on success otherwise 0
+ */
+int RaveRopoGenerator_restoreInto(RaveRopoGenerator_t* self, RaveFmiImage_t* target, int threshold);
+
+/**
+ * Same as \ref RaveRopoGenerator_restoreInto but fills in holes as \ref RaveRopoGenerator_restore2.
+ * @param[in] self - self
+ * @param[in] target - the image to write the restored data into
+ * @param[in] threshold - the probability threshold
+ * @return 1 on success otherwise 0
+ */
+int RaveRopoGenerator_restore2Into(RaveRopoGenerator_t* self, RaveFmiImage_t* target, int threshold);
+
+/**
+ * Same as \ref RaveRopoGenerator_restoreInto but fills in anomalies as \ref RaveRopoGenerator_restorePyramid.
+ * @param[in] self - self
+ * @param[in] target - the image to write the restored data into
+ * @param[in] threshold - the probability threshold
+ * @return 1 on success otherwise 0
+ */
+int RaveRopoGenerator_restorePyramidInto(RaveRopoGenerator_t* self, RaveFmiImage_t* target, int threshold);
+
+/**
+ * Applies the classification directly to a polar scan parameter by setting
+ * the gates with probability >= threshold to the undetect value of the parameter.
+ * Other gates are left untouched, so the parameter should be the one the generator
+ * image was read from. The parameter must have the same dimensions as the image.
+ * @param[in] self - self
+ * @param[in] param - the parameter to restore
+ * @param[in] threshold - the probability threshold
+ * @return 1 on success otherwise 0
+ */
+int RaveRopoGenerator_restoreParameter(RaveRopoGenerator_t* self, PolarScanParam_t* param, int threshold);
+
+/**
+ * Restores self. Gives the same result as \ref RaveRopoGenerator_restore followed
  * by a \ref RaveRopoGenerator_setImage but the probability fields aren't
- * removed.
+ * removed. The image is restored in place, i.e. the image the generator was
+ * created with is modified and no copy is made.
  * @param[in] self - self
  * @param[in] threshold - the probability threshold
  * @return 1 on success otherwise 0
@@ -248,12 +392,16 @@ int RaveRopoGenerator_getProbabilityFieldCount(RaveRopoGenerator_t* self);
  * Returns the probability field at the specified index.
  * @param[in] self - self
  * @param[in] index - the index of the field
- * @return the probability field on success otherwise NULL
+ * @return the probability field on success otherwise NULL. NULL is also returned
+ * when the field was not kept, see \ref RaveRopoGenerator_setKeepProbabilities
  */
 RaveFmiImage_t* RaveRopoGenerator_getProbabilityField(RaveRopoGenerator_t* self, int index);
 
 /**
- * Returns the a classification probability field.
+ * Returns the a classification probability field. Note that this is the generator's
+ * own field and not a copy, it is updated in place each time another detector is run
+ * until \ref RaveRopoGenerator_declassify is called. Convert it, e.g. with
+ * \ref RaveFmiImage_toRaveField, to keep the result at a certain point.
  * @param[in] self - self
  * @return the classification field that is determined from all run detectors.
  */
@@ -261,7 +409,8 @@ RaveFmiImage_t* RaveRopoGenerator_getClassification(RaveRopoGenerator_t* self);
 
 /**
  * Returns the a field containing information what detector has
- * contributed to the probability field.
+ * contributed to the probability field. Like the classification this is the
+ * generator's own field and it is updated in place when detectors are run.
  * @param[in] self - self
  * @return the markers field
  */
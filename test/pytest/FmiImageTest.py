@@ -9,6 +9,7 @@ import _raveio
 import _fmiimage
 import _rave
 import numpy
+import math
 
 class FmiImageTest(unittest.TestCase):
   PVOL_TESTFILE="fixtures/pvol_seang_20090501T120000Z.h5"
@@ -61,6 +62,51 @@ class FmiImageTest(unittest.TestCase):
     self.assertEqual(1, a.getValue(1,1))
     self.assertAlmostEqual(2.0, a.getOriginalValue(1,1), 4)
 
+  def bruteForceDistance(self, gates, width, height, rangeStep, azimuthStep, wrap):
+    result = numpy.full((height, width), numpy.inf)
+    for y in range(height):
+      for x in range(width):
+        a = azimuthStep
+        if a <= 0:
+          a = 2 * math.pi * (x + 0.5) * rangeStep / height
+        for (gx, gy) in gates:
+          dy = abs(gy - y)
+          if wrap:
+            dy = min(dy, height - dy)
+          result[y][x] = min(result[y][x], ((gx - x) * rangeStep)**2 + (dy * a)**2)
+    return result
+
+  def testDistanceTransform(self):
+    gates = [(1,0),(7,1),(3,5),(10,8)]
+    a = _fmiimage.new(12, 9)
+    for x in range(12):
+      for y in range(9):
+        a.setValue(x, y, 0)
+    for (x, y) in gates:
+      a.setValue(x, y, 200)
+    for azimuthStep in [1.5, 0.0]:
+      for wrap in [0, 1]:
+        expected = self.bruteForceDistance(gates, 12, 9, 2.0, azimuthStep, wrap)
+        actual = a.distanceTransform(2.0, azimuthStep, wrap)
+        self.assertEqual((9, 12), actual.shape)
+        self.assertTrue(numpy.allclose(expected, actual, rtol=1e-5))
+
+  def testDistanceTransform_wrapShortensDistance(self):
+    a = _fmiimage.new(4, 10)
+    for x in range(4):
+      for y in range(10):
+        a.setValue(x, y, 0)
+    a.setValue(2, 0, 1)
+    self.assertAlmostEqual(81.0, a.distanceTransform(1.0, 1.0)[9][2], 4)
+    self.assertAlmostEqual(1.0, a.distanceTransform(1.0, 1.0, 1)[9][2], 4)
+
+  def testDistanceTransform_noGates(self):
+    a = _fmiimage.new(4, 3)
+    for x in range(4):
+      for y in range(3):
+        a.setValue(x, y, 0)
+    self.assertTrue(numpy.all(numpy.isinf(a.distanceTransform(1.0, 1.0, 1))))
+
   def testFromRave_scan(self):
     a = _raveio.open(self.PVOL_TESTFILE)
     scan = a.object.getScan(0)
@@ -75,6 +75,116 @@ class PyRopoGeneratorTest(unittest.TestCase):
     c=b.speck(-20, 5).restore(50).toPolarScan().getParameter("DBZH")
     self.assertAlmostEqual(254.0, c.undetect, 4)
 
+  def testAzimuthWrap(self):
+    a = _ropogenerator.new()
+    self.assertEqual(False, a.azimuthWrap)
+    a.azimuthWrap = True
+    self.assertEqual(True, a.azimuthWrap)
+    a.azimuthWrap = False
+    self.assertEqual(False, a.azimuthWrap)
+
+  def testSpeck_azimuthWrap(self):
+    a = _raveio.open(self.PVOL_RIX_TESTFILE).object.getScan(0)
+    b = _ropogenerator.new(_fmiimage.fromRave(a, "DBZH"))
+    b.azimuthWrap = True
+    b.speck(-20, 5)
+
+  def testSpeck_areasAcrossWrap(self):
+    a = _fmiimage.new(20, 10)
+    for x in range(20):
+      for y in range(10):
+        a.setValue(x, y, 0)
+    for x, y in [(5,0),(6,0),(5,9),(12,4),(13,4),(14,4),(2,5),(2,6),(17,7)]:
+      a.setValue(x, y, 100)
+    b = _ropogenerator.new(a)
+    b.azimuthWrap = True
+    c = b.speck(10, 5).classify().classification
+    self.assertEqual(c.getValue(12,4), c.getValue(5,0))
+    self.assertEqual(c.getValue(12,4), c.getValue(5,9))
+    self.assertNotEqual(c.getValue(2,5), c.getValue(5,0))
+    b = _ropogenerator.new(a)
+    c = b.speck(10, 5).classify().classification
+    self.assertEqual(c.getValue(2,5), c.getValue(5,0))
+    self.assertEqual(c.getValue(17,7), c.getValue(5,9))
+    self.assertNotEqual(c.getValue(12,4), c.getValue(5,0))
+    self.assertEqual(0, c.getValue(0,3))
+
+  def testKeepProbabilities(self):
+    a = _ropogenerator.new()
+    self.assertEqual(True, a.keepProbabilities)
+    a.keepProbabilities = False
+    self.assertEqual(False, a.keepProbabilities)
+    a.keepProbabilities = True
+    self.assertEqual(True, a.keepProbabilities)
+
+  def testKeepProbabilities_sameClassification(self):
+    a = _raveio.open(self.PVOL_RIX_TESTFILE).object.getScan(0)
+    b = _ropogenerator.new(_fmiimage.fromRave(a, "DBZH"))
+    b.speck(-20, 5).emitter(-10, 4).softcut(-10, 250, 100)
+    c = _ropogenerator.new(_fmiimage.fromRave(a, "DBZH"))
+    c.keepProbabilities = False
+    c.speck(-20, 5).emitter(-10, 4).softcut(-10, 250, 100)
+    self.assertEqual(3, c.getProbabilityFieldCount())
+    self.assertTrue(numpy.array_equal(b.classification.toRaveField().getData(), c.classification.toRaveField().getData()))
+    self.assertTrue(numpy.array_equal(b.markers.toRaveField().getData(), c.markers.toRaveField().getData()))
+    self.assertEqual(b.classification.getAttribute("how/task_args"), c.classification.getAttribute("how/task_args"))
+    try:
+      c.getProbabilityField(1)
+      self.fail("Expected RuntimeWarning")
+    except RuntimeWarning:
+      pass
+
+  def testProbabilityField_noOriginalValue(self):
+    a = _raveio.open(self.PVOL_RIX_TESTFILE).object.getScan(0)
+    b = _ropogenerator.new(_fmiimage.fromRave(a, "DBZH"))
+    c = b.speck(-20, 5).getProbabilityField(0)
+    self.assertTrue(c.getValue(1, 1) >= 0)
+    try:
+      c.getOriginalValue(1, 1)
+      self.fail("Expected RuntimeError")
+    except RuntimeError:
+      pass
+
+  def testRestoreInto_probabilityField(self):
+    a = _raveio.open(self.PVOL_RIX_TESTFILE).object.getScan(0)
+    b = _ropogenerator.new(_fmiimage.fromRave(a, "DBZH"))
+    c = b.speck(-20, 5).getProbabilityField(0)
+    try:
+      b.restoreInto(c, 50)
+      self.fail("Expected RuntimeWarning")
+    except RuntimeWarning:
+      pass
+
+  def testGetProbabilityField_outOfRange(self):
+    a = _raveio.open(self.PVOL_RIX_TESTFILE).object.getScan(0)
+    b = _ropogenerator.new(_fmiimage.fromRave(a, "DBZH"))
+    b.speck(-20, 5)
+    try:
+      b.getProbabilityField(1)
+      self.fail("Expected IndexError")
+    except IndexError:
+      pass
+
+  def testClassification_isLive(self):
+    a = _raveio.open(self.PVOL_RIX_TESTFILE).object.getScan(0)
+    b = _ropogenerator.new(_fmiimage.fromRave(a, "DBZH"))
+    classification = b.speck(-20, 5).classify().classification
+    snapshot = classification.toRaveField().getData()
+    b.emitter(-10, 4)
+    self.assertTrue(numpy.array_equal(b.classification.toRaveField().getData(), classification.toRaveField().getData()))
+    self.assertTrue(numpy.all(classification.toRaveField().getData() >= snapshot))
+
+  def testClassification_updatedByDetectors(self):
+    a = _raveio.open(self.PVOL_RIX_TESTFILE).object.getScan(0)
+    b = _ropogenerator.new(_fmiimage.fromRave(a, "DBZH"))
+    b.speck(-20, 5).classify()
+    self.assertTrue(b.classification.getAttribute("how/task_args").find("EMITTER:") == -1)
+    b.emitter(-10, 4)
+    self.assertTrue(b.classification.getAttribute("how/task_args").find("EMITTER:") >= 0)
+    c = _ropogenerator.new(_fmiimage.fromRave(a, "DBZH"))
+    c.speck(-20, 5).emitter(-10, 4)
+    self.assertTrue(numpy.array_equal(c.classification.toRaveField().getData(), b.classification.toRaveField().getData()))
+
   def testSpeckNormOld(self):
     a = _raveio.open(self.PVOL_RIX_TESTFILE).object.getScan(0)
     b = _ropogenerator.new(_fmiimage.fromRave(a, "DBZH"))
@@ -120,6 +230,23 @@ class PyRopoGeneratorTest(unittest.TestCase):
     b = _ropogenerator.new(_fmiimage.fromRave(a, "DBZH"))
     b.sun(-10, 32, 3)
 
+  def testSun_closesShortGaps(self):
+    a = _fmiimage.new(200, 10)
+    for x in range(200):
+      for y in range(10):
+        a.setValue(x, y, 0)
+      a.setValue(x, 3, 100)
+      if x % 20 < 17:
+        a.setValue(x, 6, 100)
+      if x % 40 < 28:
+        a.setValue(x, 8, 100)
+    b = _ropogenerator.new(a)
+    c = b.sun(10, 32, 3).classify().classification
+    for x in range(200):
+      self.assertEqual(c.getValue(x, 3), c.getValue(x, 6))
+    self.assertNotEqual(c.getValue(30, 3), c.getValue(30, 8))
+    self.assertNotEqual(c.getValue(20, 8), c.getValue(30, 8))
+
   def testSun2(self):
     a = _raveio.open(self.PVOL_RIX_TESTFILE).object.getScan(0)
     b = _ropogenerator.new(_fmiimage.fromRave(a, "DBZH"))
@@ -130,11 +257,64 @@ class PyRopoGeneratorTest(unittest.TestCase):
     b = _ropogenerator.new(_fmiimage.fromRave(a, "DBZH"))
     b.sun2(-10, 32, 3, 45, 2).restore2(50)
 
+  def testRestorePyramid(self):
+    a = _raveio.open(self.PVOL_RIX_TESTFILE).object.getScan(0)
+    b = _ropogenerator.new(_fmiimage.fromRave(a, "DBZH"))
+    result = b.emitter2(-10, 4, 2).restorePyramid(50)
+    self.assertEqual("fi.fmi.ropo.restore_pyramid", result.getAttribute("how/task"))
+    self.assertTrue(result.getAttribute("how/task_args").find("EMITTER2:") >= 0)
+    original = b.getImage().toRaveField().getData()
+    unflagged = b.classification.toRaveField().getData() < 50
+    self.assertTrue(numpy.array_equal(original[unflagged], result.toRaveField().getData()[unflagged]))
+
+  def testRestorePyramidInto(self):
+    a = _raveio.open(self.PVOL_RIX_TESTFILE).object.getScan(0)
+    b = _ropogenerator.new(_fmiimage.fromRave(a, "DBZH"))
+    b.azimuthWrap = True
+    b.emitter2(-10, 4, 2)
+    expected = b.restorePyramid(50).toRaveField().getData()
+    target = _fmiimage.fromRave(a, "DBZH")
+    b.restorePyramidInto(target, 50)
+    self.assertTrue(numpy.array_equal(expected, target.toRaveField().getData()))
+
   def testChaining_speckEmitterEmitter2Clutter(self):
     a = _raveio.open(self.PVOL_RIX_TESTFILE).object.getScan(0)
     b = _ropogenerator.new(_fmiimage.fromRave(a, "DBZH"))
     b.speck(-20, 5).emitter(-10,4).emitter2(-10,4,2).clutter(-5,5)
 
+  def testRun(self):
+    a = _raveio.open(self.PVOL_RIX_TESTFILE).object.getScan(0)
+    b = _ropogenerator.new(_fmiimage.fromRave(a, "DBZH"))
+    b.speck(-20, 5).emitter(3,6).classify()
+    c = _ropogenerator.new(_fmiimage.fromRave(a, "DBZH"))
+    c.run("speck:-20,5; emitter:3,6").classify()
+    self.assertEqual(2, c.getProbabilityFieldCount())
+    self.assertEqual(b.classification.getAttribute("how/task_args"), c.classification.getAttribute("how/task_args"))
+    self.assertTrue(numpy.array_equal(b.classification.toRaveField().getData(), c.classification.toRaveField().getData()))
+    self.assertTrue(numpy.array_equal(b.markers.toRaveField().getData(), c.markers.toRaveField().getData()))
+
+  def testRun_invalid(self):
+    a = _raveio.open(self.PVOL_RIX_TESTFILE).object.getScan(0)
+    b = _ropogenerator.new(_fmiimage.fromRave(a, "DBZH"))
+    for pipeline in ["speck:-20,5;nodetector:1", "speck:-20", "speck:-20,5,1", "speck:-20,x"]:
+      try:
+        b.run(pipeline)
+        self.fail("Expected RuntimeWarning")
+      except RuntimeWarning:
+        pass
+    self.assertEqual(0, b.getProbabilityFieldCount())
+
+  def testDetectors(self):
+    detectors = _ropogenerator.detectors()
+    names = [d[0] for d in detectors]
+    self.assertTrue("speck" in names)
+    self.assertTrue("emitter2" in names)
+    self.assertTrue("sun2" in names)
+    speck = detectors[names.index("speck")]
+    self.assertEqual("minDbz,maxA", speck[1])
+    self.assertEqual(speck[2], detectors[names.index("speckNormOld")][2])
+    self.assertNotEqual(speck[2], detectors[names.index("emitter")][2])
+
   def testClassify(self):
     a = _raveio.open(self.PVOL_RIX_TESTFILE).object.getScan(0)
     b = _ropogenerator.new(_fmiimage.fromRave(a, "DBZH"))
@@ -227,13 +407,75 @@ class PyRopoGeneratorTest(unittest.TestCase):
   def testRestoreSelf(self):
     a = _raveio.open(self.PVOL_RIX_TESTFILE).object.getScan(0)
     b = _ropogenerator.new(_fmiimage.fromRave(a, "DBZH"))
+    c = _ropogenerator.new(_fmiimage.fromRave(a, "DBZH"))
+    expected = c.speck(-20, 5).restore(50).toRaveField().getData()
     oldimg = b.getImage()
     b.speck(-20, 5).restoreSelf(50)
     result = b.getImage()
-    self.assertTrue(result != oldimg)
+    self.assertTrue(numpy.array_equal(expected, result.toRaveField().getData()))
+    self.assertTrue(numpy.array_equal(expected, oldimg.toRaveField().getData()))
     self.assertEqual("fi.fmi.ropo.restore", result.getAttribute("how/task"))
     self.assertTrue(result.getAttribute("how/task_args").find("SPECK:") >= 0)
 
+  def testRestoreThresholds(self):
+    a = _raveio.open(self.PVOL_RIX_TESTFILE).object.getScan(0)
+    b = _ropogenerator.new(_fmiimage.fromRave(a, "DBZH"))
+    b.speck(-20, 5).emitter(-10, 4)
+    result = b.restoreThresholds([80, 108, 160])
+    self.assertEqual(3, len(result))
+    for threshold, image in zip([80, 108, 160], result):
+      expected = b.restore(threshold).toRaveField().getData()
+      self.assertTrue(numpy.array_equal(expected, image.toRaveField().getData()))
+      self.assertEqual("RESTORE_THRESH: %d"%threshold, image.getAttribute("how/task_args").split(";")[-1].strip())
+
+  def testRestoreThresholds_fractions(self):
+    a = _raveio.open(self.PVOL_RIX_TESTFILE).object.getScan(0)
+    b = _ropogenerator.new(_fmiimage.fromRave(a, "DBZH"))
+    images, fractions = b.speck(-20, 5).restoreThresholds((80, 108, 160), True)
+    self.assertEqual(3, len(images))
+    self.assertEqual(3, len(fractions))
+    self.assertTrue(1.0 >= fractions[0] >= fractions[1] >= fractions[2] >= 0.0)
+
+  def testRestoreInto(self):
+    a = _raveio.open(self.PVOL_RIX_TESTFILE).object.getScan(0)
+    b = _ropogenerator.new(_fmiimage.fromRave(a, "DBZH"))
+    target = _fmiimage.fromRave(a, "DBZH")
+    b.speck(-20, 5).restoreInto(target, 50)
+    expected = b.restore(50).toRaveField().getData()
+    self.assertTrue(numpy.array_equal(expected, target.toRaveField().getData()))
+    self.assertEqual("fi.fmi.ropo.restore", target.getAttribute("how/task"))
+    self.assertTrue(target.getAttribute("how/task_args").find("SPECK:") >= 0)
+
+  def testRestore2Into_self(self):
+    a = _raveio.open(self.PVOL_RIX_TESTFILE).object.getScan(0)
+    b = _ropogenerator.new(_fmiimage.fromRave(a, "DBZH"))
+    b.speck(-20, 5)
+    expected = b.restore2(50).toRaveField().getData()
+    b.restore2Into(b.getImage(), 50)
+    self.assertTrue(numpy.array_equal(expected, b.getImage().toRaveField().getData()))
+    self.assertEqual("fi.fmi.ropo.restore2", b.getImage().getAttribute("how/task"))
+
+  def testRestoreInto_differentSize(self):
+    a = _raveio.open(self.PVOL_RIX_TESTFILE).object.getScan(0)
+    b = _ropogenerator.new(_fmiimage.fromRave(a, "DBZH"))
+    b.speck(-20, 5)
+    try:
+      b.restoreInto(_fmiimage.new(10, 10), 50)
+      self.fail("Expected RuntimeWarning")
+    except RuntimeWarning:
+      pass
+
+  def testRestoreParameter(self):
+    a = _raveio.open(self.PVOL_RIX_TESTFILE).object.getScan(0)
+    b = _ropogenerator.new(_fmiimage.fromRave(a, "DBZH"))
+    param = a.getParameter("DBZH")
+    original = param.getData()
+    b.speck(-20, 5).restoreParameter(param, 50)
+    flagged = b.classification.toRaveField().getData() >= 50
+    data = param.getData()
+    self.assertTrue(numpy.all(data[flagged] == param.undetect))
+    self.assertTrue(numpy.array_equal(original[~flagged], data[~flagged]))
+
   def testGetProbabilityFieldCount(self):
     a = _raveio.open(self.PVOL_RIX_TESTFILE).object.getScan(0)
     b = _ropogenerator.new(_fmiimage.fromRave(a, "DBZH"))